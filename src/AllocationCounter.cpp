@@ -0,0 +1,53 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// plain thread-local counters keep the hook cheap enough to leave in the
+// compiler itself
+thread_local size_t allocationCount = 0;
+thread_local size_t allocationBytes = 0;
+
+void* countedAllocate(size_t size) {
+    allocationCount++;
+    allocationBytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+} // namespace
+
+namespace AllocationCounter {
+
+size_t getCount() { return allocationCount; }
+
+size_t getBytes() { return allocationBytes; }
+
+} // namespace AllocationCounter
+
+void* operator new(size_t size) {
+    void* mem = countedAllocate(size);
+    if (mem == nullptr) {
+        throw std::bad_alloc();
+    }
+    return mem;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void* mem) noexcept { std::free(mem); }
+
+void operator delete[](void* mem) noexcept { std::free(mem); }
+
+void operator delete(void* mem, size_t) noexcept { std::free(mem); }
+
+void operator delete[](void* mem, size_t) noexcept { std::free(mem); }
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Counts heap allocations made through the global operator new.
+ *
+ * Linking AllocationCounter.cpp into a program replaces the global
+ * operator new and delete for the whole program. Each thread keeps its own
+ * counts, so work measured on one thread is not disturbed by others.
+ */
+namespace AllocationCounter {
+
+/**
+ * Gets the number of allocations made so far on this thread.
+ */
+size_t getCount();
+
+/**
+ * Gets the total number of bytes requested so far on this thread.
+ */
+size_t getBytes();
+
+} // namespace AllocationCounter
@@ -0,0 +1,18 @@
+#include "AstArena.h"
+
+void* AstArena::allocateSlow(size_t size, size_t align) {
+    // oversized requests get a dedicated block so the current one keeps
+    // serving small nodes
+    size_t blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+    blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+    char* block = blocks.back().get();
+
+    uintptr_t start = (reinterpret_cast<uintptr_t>(block) + align - 1) &
+                      ~(uintptr_t)(align - 1);
+    if (blockSize == BLOCK_SIZE) {
+        cursor = reinterpret_cast<char*>(start + size);
+        limit = block + blockSize;
+    }
+    allocatedBytes += size;
+    return reinterpret_cast<void*>(start);
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Bump allocator owning every AST node of a single compilation.
+ *
+ * Nodes are placement-constructed into large blocks and are never destroyed
+ * individually; the whole arena is released in one go when it goes out of
+ * scope. As a result, every node type must be trivially destructible.
+ */
+class AstArena {
+public:
+    AstArena() : cursor(nullptr), limit(nullptr), allocatedBytes(0) {}
+
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    /**
+     * Constructs a new object of type T inside the arena.
+     *
+     * @param args the arguments to pass through to the constructor of T
+     * @return a pointer to the new object, owned by the arena
+     */
+    template <class T, typename... Args> T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are never destroyed");
+        void* mem = allocate(sizeof(T), alignof(T));
+        return new (mem) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Copies a string into the arena.
+     *
+     * @param str the string to copy
+     * @return a view of the copy, valid for the lifetime of the arena
+     */
+    std::string_view copyString(std::string_view str) {
+        if (str.empty()) {
+            return std::string_view();
+        }
+        char* mem = static_cast<char*>(allocate(str.size(), 1));
+        std::memcpy(mem, str.data(), str.size());
+        return std::string_view(mem, str.size());
+    }
+
+    /**
+     * Allocates a block of uninitialised memory inside the arena.
+     *
+     * @param size the number of bytes to allocate
+     * @param align the required alignment of the block
+     * @return a pointer to the start of the block
+     */
+    void* allocate(size_t size, size_t align) {
+        uintptr_t start = (reinterpret_cast<uintptr_t>(cursor) + align - 1) &
+                          ~(uintptr_t)(align - 1);
+        if (cursor == nullptr || start + size > (uintptr_t)limit) {
+            return allocateSlow(size, align);
+        }
+        cursor = reinterpret_cast<char*>(start + size);
+        allocatedBytes += size;
+        return reinterpret_cast<void*>(start);
+    }
+
+    /**
+     * Gets the total number of bytes handed out by the arena.
+     */
+    size_t getAllocatedBytes() const { return allocatedBytes; }
+
+    /**
+     * Gets the number of blocks reserved from the system allocator.
+     */
+    size_t getBlockCount() const { return blocks.size(); }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor;
+    char* limit;
+    size_t allocatedBytes;
+
+    void* allocateSlow(size_t size, size_t align);
+};
+
+/**
+ * Growable list of arena-allocated elements.
+ *
+ * Storage is taken from the arena, so the list can be embedded in AST nodes
+ * without requiring a destructor.
+ */
+template <class T> class AstList {
+public:
+    AstList(AstArena& arena)
+        : arena(&arena), elements(nullptr), length(0), capacity(0) {}
+
+    void push_back(T element) {
+        if (length == capacity) {
+            grow();
+        }
+        elements[length++] = element;
+    }
+
+    void insert(size_t pos, T element) {
+        assert(pos <= length && "insertion out of range");
+        push_back(element);
+        for (size_t i = length - 1; i > pos; i--) {
+            elements[i] = elements[i - 1];
+        }
+        elements[pos] = element;
+    }
+
+    void erase(size_t pos) {
+        assert(pos < length && "erasure out of range");
+        for (size_t i = pos + 1; i < length; i++) {
+            elements[i - 1] = elements[i];
+        }
+        length--;
+    }
+
+    void truncate(size_t size) {
+        assert(size <= length && "cannot grow through truncation");
+        length = size;
+    }
+
+    void clear() { length = 0; }
+
+    size_t size() const { return length; }
+
+    bool empty() const { return length == 0; }
+
+    T& operator[](size_t pos) { return elements[pos]; }
+
+    const T& operator[](size_t pos) const { return elements[pos]; }
+
+    T* begin() { return elements; }
+
+    T* end() { return elements + length; }
+
+    const T* begin() const { return elements; }
+
+    const T* end() const { return elements + length; }
+
+private:
+    AstArena* arena;
+    T* elements;
+    uint32_t length;
+    uint32_t capacity;
+
+    void grow() {
+        uint32_t newCapacity = capacity == 0 ? 4 : capacity * 2;
+        T* newElements = static_cast<T*>(
+            arena->allocate(newCapacity * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < length; i++) {
+            newElements[i] = elements[i];
+        }
+        elements = newElements;
+        capacity = newCapacity;
+    }
+};
@@ -0,0 +1,542 @@
+#include "AstBinary.h"
+#include "PunchException.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace AstBinary {
+
+namespace {
+
+const std::string_view MAGIC = "PAST";
+
+constexpr size_t HEADER_SIZE = 4 + 5 * 4;
+constexpr size_t STRING_SIZE = 2 * 4;
+constexpr size_t NODE_SIZE = 4 + 4 * 4;
+
+/**
+ * The fields of a node record.
+ *
+ * Children and strings are stored as indices. A list is stored as the index
+ * of its first entry in the list array; its length is kept in another field.
+ */
+struct NodeRecord {
+    AstKind kind;
+    uint8_t op = 0;
+    uint8_t flags = 0;
+    uint32_t fields[4] = {0, 0, 0, 0};
+};
+
+void appendWord(std::string& out, uint32_t word) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((word >> (8 * i)) & 0xff));
+    }
+}
+
+uint32_t loadWord(const char* data) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 |
+           uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+}
+
+/**
+ * Flattens a program into the arrays of the encoding.
+ */
+class Encoder {
+public:
+    /**
+     * Adds a node after its children.
+     *
+     * @return the index of the node
+     */
+    uint32_t addNode(const AstNode* node) {
+        NodeRecord record;
+        record.kind = node->getKind();
+        auto& fields = record.fields;
+
+        switch (node->getKind()) {
+        case AstKind::Program: {
+            const auto* program = cast<AstProgram>(node);
+            std::vector<uint32_t> entries;
+            for (auto path : program->getImports()) {
+                entries.push_back(addString(path));
+            }
+            addNodes(program->getAssignments(), entries);
+            addNodes(program->getFunctions(), entries);
+            fields[0] = addList(entries);
+            fields[1] = program->getImports().size();
+            fields[2] = program->getAssignments().size();
+            fields[3] = program->getFunctions().size();
+            break;
+        }
+        case AstKind::FunctionDecl: {
+            const auto* function = cast<AstFunctionDecl>(node);
+            std::vector<uint32_t> entries;
+            addNodes(function->getArguments(), entries);
+            addNodes(function->getStatements(), entries);
+            record.flags = function->isMemoized() ? 1 : 0;
+            fields[0] = addString(function->getName());
+            fields[1] = addList(entries);
+            fields[2] = function->getArguments().size();
+            fields[3] = function->getStatements().size();
+            break;
+        }
+        case AstKind::StatementBlock: {
+            const auto* block = cast<AstStatementBlock>(node);
+            std::vector<uint32_t> entries;
+            addNodes(block->getStatements(), entries);
+            fields[0] = addList(entries);
+            fields[1] = entries.size();
+            break;
+        }
+        case AstKind::Assignment: {
+            const auto* assignment = cast<AstAssignment>(node);
+            record.flags = assignment->isDeclaration() ? 1 : 0;
+            fields[0] = addNode(assignment->getVariable());
+            fields[1] = addNode(assignment->getExpression());
+            break;
+        }
+        case AstKind::Return:
+            fields[0] = addNode(cast<AstReturn>(node)->getExpression());
+            break;
+        case AstKind::SimpleConditional: {
+            const auto* conditional = cast<AstSimpleConditional>(node);
+            fields[0] = addNode(conditional->getCondition());
+            fields[1] = addNode(conditional->getIfBranch());
+            break;
+        }
+        case AstKind::BranchingConditional: {
+            const auto* conditional = cast<AstBranchingConditional>(node);
+            fields[0] = addNode(conditional->getCondition());
+            fields[1] = addNode(conditional->getIfBranch());
+            fields[2] = addNode(conditional->getElseBranch());
+            break;
+        }
+        case AstKind::ForLoop: {
+            const auto* loop = cast<AstForLoop>(node);
+            fields[0] = addNode(loop->getInit());
+            fields[1] = addNode(loop->getCondition());
+            fields[2] = addNode(loop->getStep());
+            fields[3] = addNode(loop->getBody());
+            break;
+        }
+        case AstKind::WhileLoop: {
+            const auto* loop = cast<AstWhileLoop>(node);
+            fields[0] = addNode(loop->getCondition());
+            fields[1] = addNode(loop->getBody());
+            break;
+        }
+        case AstKind::Variable:
+            fields[0] = addString(cast<AstVariable>(node)->getName());
+            break;
+        case AstKind::FunctionCall: {
+            const auto* call = cast<AstFunctionCall>(node);
+            std::vector<uint32_t> entries;
+            addNodes(call->getArguments(), entries);
+            fields[0] = addString(call->getName());
+            fields[1] = addList(entries);
+            fields[2] = entries.size();
+            break;
+        }
+        case AstKind::BinaryExpression: {
+            const auto* binary = cast<AstBinaryExpression>(node);
+            record.op = static_cast<uint8_t>(binary->getOperator());
+            fields[0] = addNode(binary->getLHS());
+            fields[1] = addNode(binary->getRHS());
+            break;
+        }
+        case AstKind::NumberLiteral: {
+            auto number = static_cast<uint64_t>(
+                cast<AstNumberLiteral>(node)->getNumber());
+            fields[0] = static_cast<uint32_t>(number);
+            fields[1] = static_cast<uint32_t>(number >> 32);
+            break;
+        }
+        case AstKind::StringLiteral:
+            fields[0] = addString(cast<AstStringLiteral>(node)->getString());
+            break;
+        case AstKind::RawBashExpression:
+            fields[0] =
+                addString(cast<AstRawBashExpression>(node)->getExpression());
+            break;
+        case AstKind::RawPunchExpression:
+            fields[0] =
+                addNode(cast<AstRawPunchExpression>(node)->getExpression());
+            break;
+        case AstKind::RawEnvironment: {
+            const auto* raw = cast<AstRawEnvironment>(node);
+            std::vector<uint32_t> entries;
+            addNodes(raw->getExpressions(), entries);
+            fields[0] = addList(entries);
+            fields[1] = entries.size();
+            break;
+        }
+        case AstKind::BinaryComparison: {
+            const auto* comp = cast<AstBinaryComparison>(node);
+            record.op = static_cast<uint8_t>(comp->getOperator());
+            fields[0] = addNode(comp->getLHS());
+            fields[1] = addNode(comp->getRHS());
+            break;
+        }
+        case AstKind::Conjunction: {
+            const auto* conj = cast<AstConjunction>(node);
+            fields[0] = addNode(conj->getLHS());
+            fields[1] = addNode(conj->getRHS());
+            break;
+        }
+        case AstKind::Disjunction: {
+            const auto* disj = cast<AstDisjunction>(node);
+            fields[0] = addNode(disj->getLHS());
+            fields[1] = addNode(disj->getRHS());
+            break;
+        }
+        case AstKind::Negation:
+            fields[0] = addNode(cast<AstNegation>(node)->getCondition());
+            break;
+        case AstKind::True:
+        case AstKind::False: break;
+        }
+
+        nodes.push_back(record);
+        return nodes.size() - 1;
+    }
+
+    /**
+     * Writes out the encoding of everything added so far.
+     */
+    void write(std::ostream& out) const {
+        std::string header(MAGIC);
+        appendWord(header, FORMAT_VERSION);
+        appendWord(header, stringSpans.size());
+        appendWord(header, nodes.size());
+        appendWord(header, lists.size());
+        appendWord(header, stringData.size());
+        out << header;
+
+        std::string spans;
+        for (const auto& [offset, length] : stringSpans) {
+            appendWord(spans, offset);
+            appendWord(spans, length);
+        }
+        out << spans;
+
+        std::string records;
+        for (const auto& record : nodes) {
+            records.push_back(static_cast<char>(record.kind));
+            records.push_back(static_cast<char>(record.op));
+            records.push_back(static_cast<char>(record.flags));
+            records.push_back(0);
+            for (uint32_t field : record.fields) {
+                appendWord(records, field);
+            }
+        }
+        out << records;
+
+        std::string entries;
+        for (uint32_t entry : lists) {
+            appendWord(entries, entry);
+        }
+        out << entries << stringData;
+    }
+
+private:
+    std::vector<NodeRecord> nodes;
+    std::vector<uint32_t> lists;
+    std::vector<std::pair<uint32_t, uint32_t>> stringSpans;
+    std::string stringData;
+
+    // indices of the strings added so far, by their text
+    std::unordered_map<std::string, uint32_t> strings;
+
+    template <class T>
+    void addNodes(const AstList<T*>& children, std::vector<uint32_t>& entries) {
+        for (const auto* child : children) {
+            entries.push_back(addNode(child));
+        }
+    }
+
+    /**
+     * Adds the entries of a list, once any nodes they refer to are added.
+     *
+     * @return the index of the first entry
+     */
+    uint32_t addList(const std::vector<uint32_t>& entries) {
+        uint32_t start = lists.size();
+        lists.insert(lists.end(), entries.begin(), entries.end());
+        return start;
+    }
+
+    uint32_t addString(std::string_view text) {
+        auto [pos, added] =
+            strings.emplace(std::string(text), stringSpans.size());
+        if (added) {
+            stringSpans.emplace_back(stringData.size(), text.size());
+            stringData.append(text);
+        }
+        return pos->second;
+    }
+};
+
+/**
+ * Rebuilds a program from its encoding, checking every index as it goes.
+ */
+class Decoder {
+public:
+    Decoder(std::string_view data, AstArena& arena, const std::string& name)
+        : data(data), arena(arena), name(name) {}
+
+    AstProgram* decode() {
+        if (data.size() < HEADER_SIZE || data.substr(0, 4) != MAGIC) {
+            generateError();
+        }
+        if (loadWord(data.data() + 4) != FORMAT_VERSION) {
+            throw IOException("'" + name + "' was encoded by another version "
+                              "of punch");
+        }
+        uint64_t stringCount = loadWord(data.data() + 8);
+        uint64_t nodeCount = loadWord(data.data() + 12);
+        uint64_t listLength = loadWord(data.data() + 16);
+        uint64_t dataSize = loadWord(data.data() + 20);
+
+        uint64_t size = HEADER_SIZE + stringCount * STRING_SIZE +
+                        nodeCount * NODE_SIZE + listLength * 4 + dataSize;
+        if (nodeCount == 0 || data.size() != size) {
+            generateError();
+        }
+        spans = data.data() + HEADER_SIZE;
+        records = spans + stringCount * STRING_SIZE;
+        lists = records + nodeCount * NODE_SIZE;
+        stringData = std::string_view(lists + listLength * 4, dataSize);
+        this->stringCount = stringCount;
+        this->listLength = listLength;
+
+        // one array for the whole program, not one allocation per node
+        nodes.assign(nodeCount, nullptr);
+        used.assign(nodeCount, false);
+        for (size_t i = 0; i < nodeCount; i++) {
+            nodes[i] = decodeNode(records + i * NODE_SIZE);
+        }
+
+        // the root is the only node without a parent
+        auto* program = dyn_cast<AstProgram>(nodes.back());
+        if (program == nullptr || used.back()) {
+            generateError();
+        }
+        return program;
+    }
+
+private:
+    std::string_view data;
+    AstArena& arena;
+    const std::string& name;
+
+    const char* spans = nullptr;
+    const char* records = nullptr;
+    const char* lists = nullptr;
+    std::string_view stringData;
+    size_t stringCount = 0;
+    size_t listLength = 0;
+
+    // the nodes decoded so far, and which of them have a parent already
+    std::vector<AstNode*> nodes;
+    std::vector<bool> used;
+
+    AstNode* decodeNode(const char* record) {
+        auto kind = static_cast<AstKind>(record[0]);
+        auto op = static_cast<uint8_t>(record[1]);
+        bool flag = record[2] != 0;
+        uint32_t fields[4];
+        for (int i = 0; i < 4; i++) {
+            fields[i] = loadWord(record + 4 + 4 * i);
+        }
+
+        switch (kind) {
+        case AstKind::Program: {
+            auto* program = arena.create<AstProgram>(arena);
+            uint32_t entry = fields[0];
+            checkList(entry, uint64_t(fields[1]) + fields[2] + fields[3]);
+            for (uint32_t i = 0; i < fields[1]; i++) {
+                program->addImport(getString(loadEntry(entry++)));
+            }
+            for (uint32_t i = 0; i < fields[2]; i++) {
+                program->addAssignment(getChild<AstAssignment>(entry++));
+            }
+            for (uint32_t i = 0; i < fields[3]; i++) {
+                program->addFunction(getChild<AstFunctionDecl>(entry++));
+            }
+            return program;
+        }
+        case AstKind::FunctionDecl: {
+            auto* function =
+                arena.create<AstFunctionDecl>(arena, getString(fields[0]));
+            function->setMemoized(flag);
+            uint32_t entry = fields[1];
+            checkList(entry, uint64_t(fields[2]) + fields[3]);
+            for (uint32_t i = 0; i < fields[2]; i++) {
+                function->addArgument(getChild<AstVariable>(entry++));
+            }
+            for (uint32_t i = 0; i < fields[3]; i++) {
+                function->addStatement(getChild<AstStatement>(entry++));
+            }
+            return function;
+        }
+        case AstKind::StatementBlock: {
+            auto* block = arena.create<AstStatementBlock>(arena);
+            checkList(fields[0], fields[1]);
+            for (uint32_t i = 0; i < fields[1]; i++) {
+                block->appendStatement(
+                    getChild<AstStatement>(fields[0] + i));
+            }
+            return block;
+        }
+        case AstKind::Assignment:
+            return arena.create<AstAssignment>(
+                flag, getNode<AstVariable>(fields[0]),
+                getNode<AstExpression>(fields[1]));
+        case AstKind::Return:
+            return arena.create<AstReturn>(getNode<AstExpression>(fields[0]));
+        case AstKind::SimpleConditional:
+            return arena.create<AstSimpleConditional>(
+                getNode<AstCondition>(fields[0]),
+                getNode<AstStatement>(fields[1]));
+        case AstKind::BranchingConditional:
+            return arena.create<AstBranchingConditional>(
+                getNode<AstCondition>(fields[0]),
+                getNode<AstStatement>(fields[1]),
+                getNode<AstStatement>(fields[2]));
+        case AstKind::ForLoop:
+            return arena.create<AstForLoop>(
+                getNode<AstStatement>(fields[0]),
+                getNode<AstCondition>(fields[1]),
+                getNode<AstStatement>(fields[2]),
+                getNode<AstStatementBlock>(fields[3]));
+        case AstKind::WhileLoop:
+            return arena.create<AstWhileLoop>(
+                getNode<AstCondition>(fields[0]),
+                getNode<AstStatementBlock>(fields[1]));
+        case AstKind::Variable:
+            return arena.create<AstVariable>(getString(fields[0]));
+        case AstKind::FunctionCall: {
+            auto* call =
+                arena.create<AstFunctionCall>(arena, getString(fields[0]));
+            checkList(fields[1], fields[2]);
+            for (uint32_t i = 0; i < fields[2]; i++) {
+                call->addArgument(getChild<AstExpression>(fields[1] + i));
+            }
+            return call;
+        }
+        case AstKind::BinaryExpression:
+            if (op > static_cast<uint8_t>(BinaryOperator::MOD)) {
+                generateError();
+            }
+            return arena.create<AstBinaryExpression>(
+                static_cast<BinaryOperator>(op),
+                getNode<AstExpression>(fields[0]),
+                getNode<AstExpression>(fields[1]));
+        case AstKind::NumberLiteral: {
+            uint64_t number = uint64_t(fields[1]) << 32 | fields[0];
+            return arena.create<AstNumberLiteral>(
+                static_cast<int64_t>(number));
+        }
+        case AstKind::StringLiteral:
+            return arena.create<AstStringLiteral>(getString(fields[0]));
+        case AstKind::RawBashExpression:
+            return arena.create<AstRawBashExpression>(getString(fields[0]));
+        case AstKind::RawPunchExpression:
+            return arena.create<AstRawPunchExpression>(
+                getNode<AstExpression>(fields[0]));
+        case AstKind::RawEnvironment: {
+            auto* raw = arena.create<AstRawEnvironment>(arena);
+            checkList(fields[0], fields[1]);
+            for (uint32_t i = 0; i < fields[1]; i++) {
+                raw->addRawExpression(
+                    getChild<AstRawExpression>(fields[0] + i));
+            }
+            return raw;
+        }
+        case AstKind::BinaryComparison:
+            if (op > static_cast<uint8_t>(ComparisonOperator::NE)) {
+                generateError();
+            }
+            return arena.create<AstBinaryComparison>(
+                static_cast<ComparisonOperator>(op),
+                getNode<AstExpression>(fields[0]),
+                getNode<AstExpression>(fields[1]));
+        case AstKind::Conjunction:
+            return arena.create<AstConjunction>(
+                getNode<AstCondition>(fields[0]),
+                getNode<AstCondition>(fields[1]));
+        case AstKind::Disjunction:
+            return arena.create<AstDisjunction>(
+                getNode<AstCondition>(fields[0]),
+                getNode<AstCondition>(fields[1]));
+        case AstKind::Negation:
+            return arena.create<AstNegation>(getNode<AstCondition>(fields[0]));
+        case AstKind::True: return arena.create<AstTrue>();
+        case AstKind::False: return arena.create<AstFalse>();
+        }
+        generateError();
+    }
+
+    /**
+     * Gets an earlier node as the child of the node being decoded.
+     *
+     * A node may only have one parent, so the result is always a tree.
+     */
+    template <class T> T* getNode(uint32_t index) {
+        if (index >= nodes.size() || nodes[index] == nullptr ||
+            used[index] || !isa<T>(nodes[index])) {
+            generateError();
+        }
+        used[index] = true;
+        return cast<T>(nodes[index]);
+    }
+
+    /**
+     * Gets the child a list entry refers to.
+     */
+    template <class T> T* getChild(uint32_t entry) {
+        return getNode<T>(loadEntry(entry));
+    }
+
+    uint32_t loadEntry(uint32_t entry) const {
+        return loadWord(lists + size_t(entry) * 4);
+    }
+
+    void checkList(uint32_t start, uint64_t length) {
+        if (start + length > listLength) {
+            generateError();
+        }
+    }
+
+    std::string_view getString(uint32_t index) {
+        if (index >= stringCount) {
+            generateError();
+        }
+        uint64_t offset = loadWord(spans + size_t(index) * STRING_SIZE);
+        uint64_t length = loadWord(spans + size_t(index) * STRING_SIZE + 4);
+        if (offset + length > stringData.size()) {
+            generateError();
+        }
+        return stringData.substr(offset, length);
+    }
+
+    [[noreturn]] void generateError() {
+        throw IOException("'" + name + "' is not a valid punch AST");
+    }
+};
+
+} // namespace
+
+void write(const AstProgram* program, std::ostream& out) {
+    Encoder encoder;
+    encoder.addNode(program);
+    encoder.write(out);
+}
+
+AstProgram* read(std::string_view data, AstArena& arena,
+                 const std::string& name) {
+    return Decoder(data, arena, name).decode();
+}
+
+} // namespace AstBinary
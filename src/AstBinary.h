@@ -0,0 +1,63 @@
+#pragma once
+
+#include "AstArena.h"
+#include "AstProgram.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Compact binary encoding of a parsed program, so later compilations can
+ * skip scanning and parsing.
+ *
+ * An encoded program is a header followed by four flat arrays:
+ *
+ *     header   magic "PAST", then as 32-bit words the format version, the
+ *              number of strings, of nodes and of list entries, and the
+ *              size of the string data
+ *     strings  an offset and a length into the string data for each string
+ *     nodes    a fixed-size record for each node: its kind, an operator, a
+ *              flag byte and four 32-bit fields
+ *     lists    32-bit indices of the nodes, or strings, in child lists
+ *     data     the text of every distinct string, each stored once
+ *
+ * Nodes refer to their children by index rather than by pointer, and every
+ * child precedes its parent, so the root program is the last node. All
+ * words are little-endian.
+ *
+ * Loading makes no heap allocation per node: nodes are created in the arena
+ * in a single pass over the array, and strings are views straight into the
+ * encoded data, which must therefore outlive the program. An encoding mapped
+ * in with SourceBuffer is used in place.
+ */
+namespace AstBinary {
+
+/**
+ * Version of the encoding; bump it whenever the layout or the AST changes.
+ */
+constexpr uint32_t FORMAT_VERSION = 1;
+
+/**
+ * Encodes a program.
+ *
+ * @param program the program to encode
+ * @param out the stream to write the encoding to
+ */
+void write(const AstProgram* program, std::ostream& out);
+
+/**
+ * Decodes a program.
+ *
+ * @param data the encoding, which the program's strings point into
+ * @param arena the arena to allocate the nodes in
+ * @param name the name of the encoding's source, for diagnostics
+ * @return the program
+ *
+ * @throws IOException if the data is not a valid encoding of this version
+ */
+AstProgram* read(std::string_view data, AstArena& arena,
+                 const std::string& name);
+
+} // namespace AstBinary
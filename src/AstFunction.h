@@ -1,39 +1,54 @@
 #pragma once
 
+#include "AstArena.h"
 #include "AstNode.h"
 #include "AstStatement.h"
-#include "Tools.h"
 
-#include <vector>
+#include <string_view>
 
 class AstFunctionDecl : public AstNode {
 public:
-    AstFunctionDecl(std::string name) : name(name) {}
+    AstFunctionDecl(AstArena& arena, std::string_view name)
+        : AstNode(AstKind::FunctionDecl), name(name), args(arena),
+          stmts(arena), memoized(false) {}
 
-    AstFunctionDecl(std::string name,
-                    std::vector<std::unique_ptr<AstVariable>> args,
-                    std::vector<std::unique_ptr<AstStatement>> stmts)
-        : name(name), args(std::move(args)), stmts(std::move(stmts)) {}
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::FunctionDecl;
+    }
 
-    std::string getName() const { return name; }
+    std::string_view getName() const { return name; }
 
-    std::vector<AstVariable*> getArguments() const {
-        return Tools::toPtrVector(args);
-    }
+    const AstList<AstVariable*>& getArguments() const { return args; }
 
-    std::vector<AstStatement*> getStatements() const {
-        return Tools::toPtrVector(stmts);
-    }
+    const AstList<AstStatement*>& getStatements() const { return stmts; }
 
-    void addArgument(std::unique_ptr<AstVariable> var) {
-        args.push_back(std::move(var));
-    }
+    AstList<AstStatement*>& getStatements() { return stmts; }
+
+    void addArgument(AstVariable* var) { args.push_back(var); }
+
+    void addStatement(AstStatement* stmt) { stmts.push_back(stmt); }
 
-    void addStatement(std::unique_ptr<AstStatement> stmt) {
-        stmts.push_back(std::move(stmt));
+    /**
+     * Checks whether calls should be answered from a cache of earlier
+     * results, as requested by an @memo annotation.
+     */
+    bool isMemoized() const { return memoized; }
+
+    void setMemoized(bool value) { memoized = value; }
+
+    void apply(const AstNodeMapper& map) override {
+        for (auto& arg : args) {
+            arg = map(arg);
+        }
+        for (auto& stmt : stmts) {
+            stmt = map(stmt);
+        }
     }
 
     virtual void print(std::ostream& os) const {
+        if (memoized) {
+            os << "@memo ";
+        }
         os << "func " << name << " ";
 
         if (args.empty()) {
@@ -49,14 +64,15 @@ public:
         }
 
         os << " {" << std::endl;
-        for (const auto& stmt : stmts) {
+        for (const auto* stmt : stmts) {
             os << "\t" << *stmt << ";" << std::endl;
         }
         os << "}";
     }
 
 private:
-    std::string name;
-    std::vector<std::unique_ptr<AstVariable>> args;
-    std::vector<std::unique_ptr<AstStatement>> stmts;
+    std::string_view name;
+    AstList<AstVariable*> args;
+    AstList<AstStatement*> stmts;
+    bool memoized;
 };
@@ -1,13 +1,124 @@
 #pragma once
 
+#include <cassert>
+#include <cstdint>
 #include <iostream>
 
+/**
+ * Tag identifying the concrete type of an AST node.
+ *
+ * Enumerators mirror the class names. Kinds sharing an abstract base class
+ * are kept contiguous so that the base class can be tested with a range
+ * check.
+ */
+enum class AstKind : uint8_t {
+    Program,
+    FunctionDecl,
+
+    // statements
+    StatementBlock,
+    Assignment,
+    Return,
+    SimpleConditional,
+    BranchingConditional,
+    ForLoop,
+    WhileLoop,
+
+    // expressions (also statements)
+    Variable,
+    FunctionCall,
+    BinaryExpression,
+    NumberLiteral,
+    StringLiteral,
+    RawBashExpression,
+    RawPunchExpression,
+    RawEnvironment,
+
+    // conditions
+    BinaryComparison,
+    Conjunction,
+    Disjunction,
+    Negation,
+    True,
+    False,
+};
+
+class AstNodeMapper;
+
 class AstNode {
 public:
+    AstNode(AstKind kind) : kind(kind) {}
+
+    AstKind getKind() const { return kind; }
+
+    /**
+     * Replaces each direct child of this node with its image under the given
+     * mapper.
+     */
+    virtual void apply(const AstNodeMapper& map) {}
+
     virtual void print(std::ostream& os) const = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const AstNode& node) {
         node.print(os);
         return os;
     }
+
+private:
+    AstKind kind;
+};
+
+/**
+ * Checks whether a node is an instance of the given AST class, using the kind
+ * tag rather than RTTI.
+ */
+template <class To> bool isa(const AstNode* node) { return To::classof(node); }
+
+/**
+ * Casts a node to the given AST class, which it must be an instance of.
+ */
+template <class To> To* cast(AstNode* node) {
+    assert(isa<To>(node) && "invalid AST cast");
+    return static_cast<To*>(node);
+}
+
+template <class To> const To* cast(const AstNode* node) {
+    assert(isa<To>(node) && "invalid AST cast");
+    return static_cast<const To*>(node);
+}
+
+/**
+ * Casts a node to the given AST class if it is an instance of it.
+ *
+ * @return the cast node, or nullptr if the node is of a different class
+ */
+template <class To> To* dyn_cast(AstNode* node) {
+    return isa<To>(node) ? static_cast<To*>(node) : nullptr;
+}
+
+template <class To> const To* dyn_cast(const AstNode* node) {
+    return isa<To>(node) ? static_cast<const To*>(node) : nullptr;
+}
+
+/**
+ * Rewrites AST nodes, for use with AstNode::apply.
+ *
+ * A mapper is free to return the node it is given, possibly after changing
+ * it in place, or to return a new node allocated in the same arena.
+ */
+class AstNodeMapper {
+public:
+    virtual ~AstNodeMapper() = default;
+
+    /**
+     * Maps a node to its replacement.
+     */
+    virtual AstNode* mapNode(AstNode* node) const = 0;
+
+    /**
+     * Maps a node to a replacement of the same class.
+     */
+    template <class T> T* operator()(T* node) const {
+        return cast<T>(mapNode(node));
+    }
 };
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+
+enum class BinaryOperator : uint8_t {
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+};
+
+enum class ComparisonOperator : uint8_t {
+    LT,
+    LE,
+    GT,
+    GE,
+    EQ,
+    NE,
+};
+
+inline const char* getSymbolForBinaryOperator(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::ADD: return "+";
+        case BinaryOperator::SUB: return "-";
+        case BinaryOperator::MUL: return "*";
+        case BinaryOperator::DIV: return "/";
+        case BinaryOperator::MOD: return "%";
+    }
+
+    assert(false && "unsupported binary operator");
+}
+
+/**
+ * Gets the binding strength of a binary operator; operators with higher
+ * precedence bind more tightly.
+ */
+inline int getPrecedence(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::ADD:
+        case BinaryOperator::SUB: return 1;
+        case BinaryOperator::MUL:
+        case BinaryOperator::DIV:
+        case BinaryOperator::MOD: return 2;
+    }
+
+    assert(false && "unsupported binary operator");
+}
+
+inline const char* getSymbolForComparisonOperator(ComparisonOperator op) {
+    switch (op) {
+        case ComparisonOperator::LT: return "<";
+        case ComparisonOperator::LE: return "<=";
+        case ComparisonOperator::GT: return ">";
+        case ComparisonOperator::GE: return ">=";
+        case ComparisonOperator::EQ: return "==";
+        case ComparisonOperator::NE: return "!=";
+    }
+
+    assert(false && "unsupported comparison operator");
+}
@@ -1,20 +1,35 @@
 #pragma once
 
+#include "AstArena.h"
 #include "AstFunction.h"
 #include "AstNode.h"
 #include "AstStatement.h"
-#include "Tools.h"
 
 #include <iostream>
-#include <memory>
-#include <vector>
 
 class AstProgram : public AstNode {
 public:
+    AstProgram(AstArena& arena)
+        : AstNode(AstKind::Program), imports(arena), assignments(arena),
+          functions(arena) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Program;
+    }
+
     void print(std::ostream& os) const override {
+        if (!imports.empty()) {
+            os << "// imports" << std::endl;
+            os << std::endl;
+            for (auto path : imports) {
+                os << "import \"" << path << "\";" << std::endl;
+            }
+            os << std::endl;
+        }
+
         os << "// assignments" << std::endl;
         os << std::endl;
-        for (const auto& assignment : assignments) {
+        for (const auto* assignment : assignments) {
             assignment->print(os);
             os << ";" << std::endl;
         }
@@ -23,29 +38,46 @@ public:
 
         os << "// functions" << std::endl;
         os << std::endl;
-        for (const auto& function : functions) {
+        for (const auto* function : functions) {
             function->print(os);
             os << std::endl;
         }
     }
 
-    std::vector<AstAssignment*> getAssignments() const {
-        return Tools::toPtrVector(assignments);
+    /**
+     * Gets the paths of the modules the program imports, as written.
+     */
+    const AstList<std::string_view>& getImports() const { return imports; }
+
+    const AstList<AstAssignment*>& getAssignments() const {
+        return assignments;
     }
 
-    std::vector<AstFunctionDecl*> getFunctions() const {
-        return Tools::toPtrVector(functions);
+    const AstList<AstFunctionDecl*>& getFunctions() const { return functions; }
+
+    AstList<AstFunctionDecl*>& getFunctions() { return functions; }
+
+    void addImport(std::string_view path) { imports.push_back(path); }
+
+    void addAssignment(AstAssignment* assignment) {
+        assignments.push_back(assignment);
     }
 
-    void addAssignment(std::unique_ptr<AstAssignment> assignment) {
-        assignments.push_back(std::move(assignment));
+    void addFunction(AstFunctionDecl* function) {
+        functions.push_back(function);
     }
 
-    void addFunction(std::unique_ptr<AstFunctionDecl> function) {
-        functions.push_back(std::move(function));
+    void apply(const AstNodeMapper& map) override {
+        for (auto& assignment : assignments) {
+            assignment = map(assignment);
+        }
+        for (auto& function : functions) {
+            function = map(function);
+        }
     }
 
 private:
-    std::vector<std::unique_ptr<AstAssignment>> assignments;
-    std::vector<std::unique_ptr<AstFunctionDecl>> functions;
+    AstList<std::string_view> imports;
+    AstList<AstAssignment*> assignments;
+    AstList<AstFunctionDecl*> functions;
 };
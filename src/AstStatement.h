@@ -1,29 +1,46 @@
 #pragma once
 
+#include "AstArena.h"
 #include "AstNode.h"
-#include "Tools.h"
+#include "AstOperator.h"
 
 #include <iostream>
-#include <memory>
-#include <vector>
+#include <string_view>
 
-class AstStatement : public AstNode {};
+class AstStatement : public AstNode {
+public:
+    AstStatement(AstKind kind) : AstNode(kind) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::StatementBlock &&
+               node->getKind() <= AstKind::RawEnvironment;
+    }
+};
 
 class AstStatementBlock : public AstStatement {
 public:
-    AstStatementBlock() = default;
+    AstStatementBlock(AstArena& arena)
+        : AstStatement(AstKind::StatementBlock), stmts(arena) {}
 
-    void appendStatement(std::unique_ptr<AstStatement> stmt) {
-        stmts.push_back(std::move(stmt));
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::StatementBlock;
     }
 
-    std::vector<AstStatement*> getStatements() const {
-        return Tools::toPtrVector(stmts);
+    void appendStatement(AstStatement* stmt) { stmts.push_back(stmt); }
+
+    const AstList<AstStatement*>& getStatements() const { return stmts; }
+
+    AstList<AstStatement*>& getStatements() { return stmts; }
+
+    void apply(const AstNodeMapper& map) override {
+        for (auto& stmt : stmts) {
+            stmt = map(stmt);
+        }
     }
 
     void print(std::ostream& os) const override {
         os << "{" << std::endl;
-        for (const auto& stmt : stmts) {
+        for (const auto* stmt : stmts) {
             stmt->print(os);
             os << std::endl;
         }
@@ -31,34 +48,61 @@ public:
     }
 
 private:
-    std::vector<std::unique_ptr<AstStatement>> stmts;
+    AstList<AstStatement*> stmts;
 };
 
-class AstExpression : public AstStatement {};
+class AstExpression : public AstStatement {
+public:
+    AstExpression(AstKind kind) : AstStatement(kind) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::Variable &&
+               node->getKind() <= AstKind::RawEnvironment;
+    }
+};
 
 class AstVariable : public AstExpression {
 public:
-    AstVariable(std::string ident) : ident(ident) {}
+    AstVariable(std::string_view ident)
+        : AstExpression(AstKind::Variable), ident(ident) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Variable;
+    }
 
     // TODO: change this
-    std::string getName() const { return ident; }
+    std::string_view getName() const { return ident; }
 
     void print(std::ostream& os) const override { os << ident; }
 
 private:
-    std::string ident;
+    std::string_view ident;
 };
 
 class AstAssignment : public AstStatement {
 public:
-    AstAssignment(bool declaration, std::unique_ptr<AstVariable> var,
-                  std::unique_ptr<AstExpression> expr)
-        : declaration(declaration), var(std::move(var)), expr(std::move(expr)) {
+    AstAssignment(bool declaration, AstVariable* var, AstExpression* expr)
+        : AstStatement(AstKind::Assignment), declaration(declaration),
+          var(var), expr(expr) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Assignment;
     }
 
-    AstVariable* getVariable() const { return var.get(); }
+    /**
+     * Checks whether the assignment declares its variable, rather than
+     * updating an existing one.
+     */
+    bool isDeclaration() const { return declaration; }
 
-    AstExpression* getExpression() const { return expr.get(); }
+    AstVariable* getVariable() const { return var; }
+
+    AstExpression* getExpression() const { return expr; }
+
+    void apply(const AstNodeMapper& map) override {
+        var = map(var);
+        expr = map(expr);
+    }
 
     void print(std::ostream& os) const override {
         if (declaration) {
@@ -71,118 +115,167 @@ public:
 
 private:
     bool declaration;
-    std::unique_ptr<AstVariable> var;
-    std::unique_ptr<AstExpression> expr;
+    AstVariable* var;
+    AstExpression* expr;
 };
 
 class AstFunctionCall : public AstExpression {
 public:
-    AstFunctionCall(std::string name) : name(name) {}
+    AstFunctionCall(AstArena& arena, std::string_view name)
+        : AstExpression(AstKind::FunctionCall), name(name), args(arena) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::FunctionCall;
+    }
 
-    AstFunctionCall(std::string name,
-                    std::vector<std::unique_ptr<AstExpression>> args)
-        : name(name), args(std::move(args)) {}
+    std::string_view getName() const { return name; }
 
-    std::string getName() const { return name; }
+    const AstList<AstExpression*>& getArguments() const { return args; }
 
-    std::vector<AstExpression*> getArguments() const {
-        return Tools::toPtrVector(args);
-    }
+    void addArgument(AstExpression* expr) { args.push_back(expr); }
 
-    void addArgument(std::unique_ptr<AstExpression> expr) {
-        args.push_back(std::move(expr));
+    void apply(const AstNodeMapper& map) override {
+        for (auto& arg : args) {
+            arg = map(arg);
+        }
     }
 
     virtual void print(std::ostream& os) const {
         os << name << "(";
-
-        if (args.empty()) {
-            os << "()";
-        } else {
-            os << "(";
-            os << *args[0];
-            for (size_t i = 0; i < args.size(); i++) {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (i != 0) {
                 os << ", ";
-                os << *args[i];
             }
-            os << ")";
+            os << *args[i];
         }
+        os << ")";
     }
 
 private:
-    std::string name;
-    std::vector<std::unique_ptr<AstExpression>> args;
+    std::string_view name;
+    AstList<AstExpression*> args;
 };
 
 class AstBinaryExpression : public AstExpression {
 public:
-    AstBinaryExpression(char op, std::unique_ptr<AstExpression> lhs,
-                        std::unique_ptr<AstExpression> rhs)
-        : op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+    AstBinaryExpression(BinaryOperator op, AstExpression* lhs,
+                        AstExpression* rhs)
+        : AstExpression(AstKind::BinaryExpression), op(op), lhs(lhs),
+          rhs(rhs) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::BinaryExpression;
+    }
 
     void print(std::ostream& os) const override {
-        os << op;
+        os << getSymbolForBinaryOperator(op);
         os << "(" << *lhs << ", " << *rhs << ")";
     }
 
-    char getOperator() const { return op; }
+    BinaryOperator getOperator() const { return op; }
+
+    AstExpression* getLHS() const { return lhs; }
+
+    AstExpression* getRHS() const { return rhs; }
+
+    void setLHS(AstExpression* expr) { lhs = expr; }
 
-    AstExpression* getLHS() const { return lhs.get(); }
+    void setRHS(AstExpression* expr) { rhs = expr; }
 
-    AstExpression* getRHS() const { return rhs.get(); }
+    void apply(const AstNodeMapper& map) override {
+        lhs = map(lhs);
+        rhs = map(rhs);
+    }
 
 private:
-    char op; // TODO: use enum
-    std::unique_ptr<AstExpression> lhs;
-    std::unique_ptr<AstExpression> rhs;
+    BinaryOperator op;
+    AstExpression* lhs;
+    AstExpression* rhs;
 };
 
-class AstLiteral : public AstExpression {};
+class AstLiteral : public AstExpression {
+public:
+    AstLiteral(AstKind kind) : AstExpression(kind) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::NumberLiteral &&
+               node->getKind() <= AstKind::StringLiteral;
+    }
+};
 
 class AstNumberLiteral : public AstLiteral {
 public:
-    AstNumberLiteral(int number) : number(number) {}
+    AstNumberLiteral(int64_t number)
+        : AstLiteral(AstKind::NumberLiteral), number(number) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::NumberLiteral;
+    }
 
-    int getNumber() const { return number; }
+    int64_t getNumber() const { return number; }
 
     void print(std::ostream& os) const override { os << number; }
 
 private:
-    int number;
+    int64_t number;
 };
 
 class AstStringLiteral : public AstLiteral {
 public:
-    AstStringLiteral(std::string string) : string(string) {}
+    AstStringLiteral(std::string_view string)
+        : AstLiteral(AstKind::StringLiteral), string(string) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::StringLiteral;
+    }
 
-    std::string getString() const { return string; }
+    std::string_view getString() const { return string; }
 
     void print(std::ostream& os) const override { os << string; }
 
 private:
-    std::string string;
+    std::string_view string;
 };
 
-class AstRawExpression : public AstExpression {};
+class AstRawExpression : public AstExpression {
+public:
+    AstRawExpression(AstKind kind) : AstExpression(kind) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::RawBashExpression &&
+               node->getKind() <= AstKind::RawPunchExpression;
+    }
+};
 
 class AstRawBashExpression : public AstRawExpression {
 public:
-    AstRawBashExpression(std::string expr) : expr(expr) {}
+    AstRawBashExpression(std::string_view expr)
+        : AstRawExpression(AstKind::RawBashExpression), expr(expr) {}
 
-    std::string getExpression() const { return expr; }
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::RawBashExpression;
+    }
+
+    std::string_view getExpression() const { return expr; }
 
     void print(std::ostream& os) const override { os << expr; }
 
 private:
-    std::string expr;
+    std::string_view expr;
 };
 
 class AstRawPunchExpression : public AstRawExpression {
 public:
-    AstRawPunchExpression(std::unique_ptr<AstExpression> expr)
-        : expr(std::move(expr)) {}
+    AstRawPunchExpression(AstExpression* expr)
+        : AstRawExpression(AstKind::RawPunchExpression), expr(expr) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::RawPunchExpression;
+    }
 
-    AstExpression* getExpression() const { return expr.get(); }
+    AstExpression* getExpression() const { return expr; }
+
+    void apply(const AstNodeMapper& map) override { expr = map(expr); }
 
     void print(std::ostream& os) const override {
         os << "$[";
@@ -191,74 +284,107 @@ public:
     }
 
 private:
-    std::unique_ptr<AstExpression> expr;
+    AstExpression* expr;
 };
 
 class AstRawEnvironment : public AstExpression {
 public:
-    AstRawEnvironment() {}
+    AstRawEnvironment(AstArena& arena)
+        : AstExpression(AstKind::RawEnvironment), expressions(arena) {}
 
-    AstRawEnvironment(
-        std::vector<std::unique_ptr<AstRawExpression>> expressions)
-        : expressions(std::move(expressions)) {}
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::RawEnvironment;
+    }
 
-    std::vector<AstRawExpression*> getExpressions() const {
-        return Tools::toPtrVector(expressions);
+    const AstList<AstRawExpression*>& getExpressions() const {
+        return expressions;
     }
 
-    void addRawExpression(std::unique_ptr<AstRawExpression> expr) {
-        expressions.push_back(std::move(expr));
+    void addRawExpression(AstRawExpression* expr) {
+        expressions.push_back(expr);
+    }
+
+    void apply(const AstNodeMapper& map) override {
+        for (auto& expr : expressions) {
+            expr = map(expr);
+        }
     }
 
     void print(std::ostream& os) const override {
         os << "raw {" << std::endl;
-        for (const auto& expr : expressions) {
+        for (const auto* expr : expressions) {
             expr->print(os);
         }
         os << "}";
     }
 
 private:
-    std::vector<std::unique_ptr<AstRawExpression>> expressions;
+    AstList<AstRawExpression*> expressions;
 };
 
 class AstCondition : public AstNode {
 public:
-    AstCondition() {}
+    AstCondition(AstKind kind) : AstNode(kind) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::BinaryComparison &&
+               node->getKind() <= AstKind::False;
+    }
 };
 
 class AstBinaryComparison : public AstCondition {
 public:
-    AstBinaryComparison(std::string op, std::unique_ptr<AstExpression> lhs, std::unique_ptr<AstExpression> rhs) : op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+    AstBinaryComparison(ComparisonOperator op, AstExpression* lhs,
+                        AstExpression* rhs)
+        : AstCondition(AstKind::BinaryComparison), op(op), lhs(lhs),
+          rhs(rhs) {}
 
-    AstExpression* getLHS() const {
-        return lhs.get();
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::BinaryComparison;
     }
 
-    AstExpression* getRHS() const {
-        return rhs.get();
-    }
+    AstExpression* getLHS() const { return lhs; }
 
-    std::string getOperator() const {
-        return op;
+    AstExpression* getRHS() const { return rhs; }
+
+    ComparisonOperator getOperator() const { return op; }
+
+    void apply(const AstNodeMapper& map) override {
+        lhs = map(lhs);
+        rhs = map(rhs);
     }
 
     void print(std::ostream& os) const override {
         os << "(";
         lhs->print(os);
-        os << " " << op << " ";
+        os << " " << getSymbolForComparisonOperator(op) << " ";
         rhs->print(os);
         os << ")";
     };
+
 private:
-    std::string op;
-    std::unique_ptr<AstExpression> lhs;
-    std::unique_ptr<AstExpression> rhs;
+    ComparisonOperator op;
+    AstExpression* lhs;
+    AstExpression* rhs;
 };
 
 class AstConjunction : public AstCondition {
 public:
-    AstConjunction(std::unique_ptr<AstCondition> lhs, std::unique_ptr<AstCondition> rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+    AstConjunction(AstCondition* lhs, AstCondition* rhs)
+        : AstCondition(AstKind::Conjunction), lhs(lhs), rhs(rhs) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Conjunction;
+    }
+
+    AstCondition* getLHS() const { return lhs; }
+
+    AstCondition* getRHS() const { return rhs; }
+
+    void apply(const AstNodeMapper& map) override {
+        lhs = map(lhs);
+        rhs = map(rhs);
+    }
 
     void print(std::ostream& os) const override {
         os << "(";
@@ -269,13 +395,27 @@ public:
     }
 
 private:
-    std::unique_ptr<AstCondition> lhs;
-    std::unique_ptr<AstCondition> rhs;
+    AstCondition* lhs;
+    AstCondition* rhs;
 };
 
 class AstDisjunction : public AstCondition {
 public:
-    AstDisjunction(std::unique_ptr<AstCondition> lhs, std::unique_ptr<AstCondition> rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+    AstDisjunction(AstCondition* lhs, AstCondition* rhs)
+        : AstCondition(AstKind::Disjunction), lhs(lhs), rhs(rhs) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Disjunction;
+    }
+
+    AstCondition* getLHS() const { return lhs; }
+
+    AstCondition* getRHS() const { return rhs; }
+
+    void apply(const AstNodeMapper& map) override {
+        lhs = map(lhs);
+        rhs = map(rhs);
+    }
 
     void print(std::ostream& os) const override {
         os << "(";
@@ -286,43 +426,86 @@ public:
     }
 
 private:
-    std::unique_ptr<AstCondition> lhs;
-    std::unique_ptr<AstCondition> rhs;
+    AstCondition* lhs;
+    AstCondition* rhs;
+};
+
+class AstNegation : public AstCondition {
+public:
+    AstNegation(AstCondition* cond)
+        : AstCondition(AstKind::Negation), cond(cond) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Negation;
+    }
+
+    AstCondition* getCondition() const { return cond; }
+
+    void apply(const AstNodeMapper& map) override { cond = map(cond); }
+
+    void print(std::ostream& os) const override {
+        os << "!";
+        cond->print(os);
+    }
+
+private:
+    AstCondition* cond;
 };
 
 class AstTrue : public AstCondition {
 public:
-    AstTrue() {}
+    AstTrue() : AstCondition(AstKind::True) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::True;
+    }
 
     void print(std::ostream& os) const override { os << "true"; }
 };
 
 class AstFalse : public AstCondition {
 public:
-    AstFalse() {}
+    AstFalse() : AstCondition(AstKind::False) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::False;
+    }
 
     void print(std::ostream& os) const override { os << "false"; }
 };
 
 class AstConditional : public AstStatement {
 public:
-    AstConditional(std::unique_ptr<AstCondition> cond)
-        : cond(std::move(cond)) {}
+    AstConditional(AstKind kind, AstCondition* cond)
+        : AstStatement(kind), cond(cond) {}
+
+    AstCondition* getCondition() const { return cond; }
 
-    AstCondition* getCondition() const { return cond.get(); }
+    void apply(const AstNodeMapper& map) override { cond = map(cond); }
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::SimpleConditional &&
+               node->getKind() <= AstKind::BranchingConditional;
+    }
 
 protected:
-    std::unique_ptr<AstCondition> cond;
+    AstCondition* cond;
 };
 
 class AstSimpleConditional : public AstConditional {
 public:
-    AstSimpleConditional(std::unique_ptr<AstCondition> cond,
-                         std::unique_ptr<AstStatement> ifStmt)
-        : AstConditional(std::move(cond)), ifStmt(std::move(ifStmt)) {}
+    AstSimpleConditional(AstCondition* cond, AstStatement* ifStmt)
+        : AstConditional(AstKind::SimpleConditional, cond), ifStmt(ifStmt) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::SimpleConditional;
+    }
 
-    AstStatement* getIfBranch() const {
-        return ifStmt.get();
+    AstStatement* getIfBranch() const { return ifStmt; }
+
+    void apply(const AstNodeMapper& map) override {
+        AstConditional::apply(map);
+        ifStmt = map(ifStmt);
     }
 
     void print(std::ostream& os) const override {
@@ -333,23 +516,28 @@ public:
     }
 
 private:
-    std::unique_ptr<AstStatement> ifStmt;
+    AstStatement* ifStmt;
 };
 
 class AstBranchingConditional : public AstConditional {
 public:
-    AstBranchingConditional(std::unique_ptr<AstCondition> cond,
-                            std::unique_ptr<AstStatement> ifStmt,
-                            std::unique_ptr<AstStatement> elseStmt)
-        : AstConditional(std::move(cond)), ifStmt(std::move(ifStmt)),
-          elseStmt(std::move(elseStmt)) {}
+    AstBranchingConditional(AstCondition* cond, AstStatement* ifStmt,
+                            AstStatement* elseStmt)
+        : AstConditional(AstKind::BranchingConditional, cond),
+          ifStmt(ifStmt), elseStmt(elseStmt) {}
 
-    AstStatement* getIfBranch() const {
-        return ifStmt.get();
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::BranchingConditional;
     }
 
-    AstStatement* getElseBranch() const {
-        return elseStmt.get();
+    AstStatement* getIfBranch() const { return ifStmt; }
+
+    AstStatement* getElseBranch() const { return elseStmt; }
+
+    void apply(const AstNodeMapper& map) override {
+        AstConditional::apply(map);
+        ifStmt = map(ifStmt);
+        elseStmt = map(elseStmt);
     }
 
     void print(std::ostream& os) const override {
@@ -362,15 +550,107 @@ public:
     }
 
 private:
-    std::unique_ptr<AstStatement> ifStmt;
-    std::unique_ptr<AstStatement> elseStmt;
+    AstStatement* ifStmt;
+    AstStatement* elseStmt;
+};
+
+class AstLoop : public AstStatement {
+public:
+    AstLoop(AstKind kind, AstCondition* cond, AstStatementBlock* body)
+        : AstStatement(kind), cond(cond), body(body) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() >= AstKind::ForLoop &&
+               node->getKind() <= AstKind::WhileLoop;
+    }
+
+    AstCondition* getCondition() const { return cond; }
+
+    AstStatementBlock* getBody() const { return body; }
+
+    void apply(const AstNodeMapper& map) override {
+        cond = map(cond);
+        body = map(body);
+    }
+
+protected:
+    AstCondition* cond;
+    AstStatementBlock* body;
+};
+
+class AstForLoop : public AstLoop {
+public:
+    AstForLoop(AstStatement* init, AstCondition* cond, AstStatement* step,
+               AstStatementBlock* body)
+        : AstLoop(AstKind::ForLoop, cond, body), init(init), step(step) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::ForLoop;
+    }
+
+    /**
+     * Gets the statement run once before the loop, either an assignment or
+     * an expression.
+     */
+    AstStatement* getInit() const { return init; }
+
+    /**
+     * Gets the statement run after each iteration, either an assignment or
+     * an expression.
+     */
+    AstStatement* getStep() const { return step; }
+
+    void apply(const AstNodeMapper& map) override {
+        init = map(init);
+        AstLoop::apply(map);
+        step = map(step);
+    }
+
+    void print(std::ostream& os) const override {
+        os << "for (";
+        init->print(os);
+        os << "; ";
+        cond->print(os);
+        os << "; ";
+        step->print(os);
+        os << ") ";
+        body->print(os);
+    }
+
+private:
+    AstStatement* init;
+    AstStatement* step;
+};
+
+class AstWhileLoop : public AstLoop {
+public:
+    AstWhileLoop(AstCondition* cond, AstStatementBlock* body)
+        : AstLoop(AstKind::WhileLoop, cond, body) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::WhileLoop;
+    }
+
+    void print(std::ostream& os) const override {
+        os << "while (";
+        cond->print(os);
+        os << ") ";
+        body->print(os);
+    }
 };
 
 class AstReturn : public AstStatement {
 public:
-    AstReturn(std::unique_ptr<AstExpression> expr) : expr(std::move(expr)) {}
+    AstReturn(AstExpression* expr)
+        : AstStatement(AstKind::Return), expr(expr) {}
+
+    static bool classof(const AstNode* node) {
+        return node->getKind() == AstKind::Return;
+    }
+
+    AstExpression* getExpression() const { return expr; }
 
-    AstExpression* getExpression() const { return expr.get(); }
+    void apply(const AstNodeMapper& map) override { expr = map(expr); }
 
     void print(std::ostream& os) const override {
         os << "return ";
@@ -378,5 +658,5 @@ public:
     }
 
 private:
-    std::unique_ptr<AstExpression> expr;
+    AstExpression* expr;
 };
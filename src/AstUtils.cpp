@@ -0,0 +1,110 @@
+#include "AstUtils.h"
+#include "AstFunction.h"
+
+#include <cctype>
+
+namespace AstUtils {
+
+namespace {
+
+class StatementCallCollector : public AstNodeMapper {
+public:
+    StatementCallCollector(std::unordered_set<const AstNode*>& calls)
+        : calls(calls) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* function = dyn_cast<AstFunctionDecl>(node)) {
+            collect(function->getStatements());
+        } else if (const auto* block = dyn_cast<AstStatementBlock>(node)) {
+            collect(block->getStatements());
+        } else if (const auto* cond = dyn_cast<AstSimpleConditional>(node)) {
+            collect(cond->getIfBranch());
+        } else if (const auto* cond =
+                       dyn_cast<AstBranchingConditional>(node)) {
+            collect(cond->getIfBranch());
+            collect(cond->getElseBranch());
+        } else if (const auto* loop = dyn_cast<AstForLoop>(node)) {
+            collect(loop->getInit());
+            collect(loop->getStep());
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    std::unordered_set<const AstNode*>& calls;
+
+    void collect(const AstStatement* stmt) const {
+        if (isa<AstFunctionCall>(stmt)) {
+            calls.insert(stmt);
+        }
+    }
+
+    void collect(const AstList<AstStatement*>& stmts) const {
+        for (const auto* stmt : stmts) {
+            collect(stmt);
+        }
+    }
+};
+
+bool isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+} // namespace
+
+std::unordered_set<const AstNode*> findStatementCalls(AstNode* root) {
+    std::unordered_set<const AstNode*> calls;
+    StatementCallCollector collector(calls);
+    collector.mapNode(root);
+    return calls;
+}
+
+bool isSideEffectFree(const AstExpression* expr) {
+    switch (expr->getKind()) {
+    case AstKind::Variable:
+    case AstKind::NumberLiteral:
+    case AstKind::StringLiteral: return true;
+    case AstKind::BinaryExpression: {
+        const auto* binary = cast<AstBinaryExpression>(expr);
+        return isSideEffectFree(binary->getLHS()) &&
+               isSideEffectFree(binary->getRHS());
+    }
+    default: return false;
+    }
+}
+
+bool isTotal(const AstExpression* expr) {
+    const auto* binary = dyn_cast<AstBinaryExpression>(expr);
+    if (binary == nullptr) {
+        return isSideEffectFree(expr);
+    }
+    BinaryOperator op = binary->getOperator();
+    if (op == BinaryOperator::DIV || op == BinaryOperator::MOD) {
+        // a divisor only known at runtime may turn out to be zero
+        const auto* divisor = dyn_cast<AstNumberLiteral>(binary->getRHS());
+        if (divisor == nullptr || divisor->getNumber() == 0) {
+            return false;
+        }
+    }
+    return isTotal(binary->getLHS()) && isTotal(binary->getRHS());
+}
+
+std::vector<std::string_view> findWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (!isWordChar(text[pos])) {
+            pos++;
+            continue;
+        }
+        size_t start = pos;
+        while (pos < text.size() && isWordChar(text[pos])) {
+            pos++;
+        }
+        words.push_back(text.substr(start, pos - start));
+    }
+    return words;
+}
+
+} // namespace AstUtils
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "AstNode.h"
+#include "AstStatement.h"
+
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Queries over AST subtrees shared by the passes and the translator.
+ */
+namespace AstUtils {
+
+/**
+ * Finds the function calls appearing directly as statements below a node,
+ * i.e. the calls whose results are discarded.
+ */
+std::unordered_set<const AstNode*> findStatementCalls(AstNode* root);
+
+/**
+ * Checks whether evaluating an expression has no effect beyond producing its
+ * value; calls and raw code may do anything.
+ */
+bool isSideEffectFree(const AstExpression* expr);
+
+/**
+ * Checks whether evaluating an expression is side-effect free and cannot
+ * fail either, i.e. every division in it is by a nonzero constant.
+ */
+bool isTotal(const AstExpression* expr);
+
+/**
+ * Splits raw bash code into the words that could name a function or
+ * variable, in order of appearance.
+ *
+ * @return views into the given text
+ */
+std::vector<std::string_view> findWords(std::string_view text);
+
+} // namespace AstUtils
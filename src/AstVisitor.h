@@ -12,33 +12,39 @@ public:
     AstVisitor() = default;
 
     T visit(const AstNode* node, Args... args) {
+        switch (node->getKind()) {
 
 #define LEAF(Kind)                                                             \
-    if (const auto* n = dynamic_cast<const Ast##Kind*>(node))                  \
-        return visit##Kind(n, args...);
+    case AstKind::Kind:                                                        \
+        return visit##Kind(static_cast<const Ast##Kind*>(node), args...);
 
-        LEAF(Program);
-        LEAF(FunctionDecl);
-        LEAF(Variable);
-        LEAF(Assignment);
-        LEAF(BinaryExpression);
-        LEAF(NumberLiteral);
-        LEAF(StringLiteral);
-        LEAF(FunctionCall);
-        LEAF(RawBashExpression);
-        LEAF(RawPunchExpression);
-        LEAF(RawEnvironment);
-        LEAF(Return);
-        LEAF(SimpleConditional);
-        LEAF(BranchingConditional);
-        LEAF(True);
-        LEAF(False);
-        LEAF(StatementBlock);
-        LEAF(BinaryComparison);
+            LEAF(Program);
+            LEAF(FunctionDecl);
+            LEAF(Variable);
+            LEAF(Assignment);
+            LEAF(BinaryExpression);
+            LEAF(NumberLiteral);
+            LEAF(StringLiteral);
+            LEAF(FunctionCall);
+            LEAF(RawBashExpression);
+            LEAF(RawPunchExpression);
+            LEAF(RawEnvironment);
+            LEAF(Return);
+            LEAF(SimpleConditional);
+            LEAF(BranchingConditional);
+            LEAF(ForLoop);
+            LEAF(WhileLoop);
+            LEAF(True);
+            LEAF(False);
+            LEAF(StatementBlock);
+            LEAF(BinaryComparison);
+            LEAF(Conjunction);
+            LEAF(Disjunction);
+            LEAF(Negation);
 
 #undef LEAF
+        }
 
-        std::cerr << "Unsupported type: " << typeid(node).name() << std::endl;
         assert(false && "missing visitor type");
     }
 
@@ -69,11 +75,17 @@ protected:
     CHILD(Conditional, Statement);
     CHILD(SimpleConditional, Conditional);
     CHILD(BranchingConditional, Conditional);
+    CHILD(Loop, Statement);
+    CHILD(ForLoop, Loop);
+    CHILD(WhileLoop, Loop);
     CHILD(Condition, Node);
     CHILD(True, Condition);
     CHILD(False, Condition);
     CHILD(StatementBlock, Statement);
     CHILD(BinaryComparison, Condition);
+    CHILD(Conjunction, Condition);
+    CHILD(Disjunction, Condition);
+    CHILD(Negation, Condition);
 
 #undef CHILD
 };
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Vectorised helpers for skipping over uninteresting runs of source text.
+ *
+ * AVX2 is used when the compiler targets it, SSE2 otherwise (always available
+ * on x86-64), with a scalar fallback for other architectures. Every helper
+ * returns `end` if no matching character is found.
+ */
+namespace CharScan {
+
+inline bool isWhitespace(char chr) {
+    return chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r';
+}
+
+/**
+ * Finds the first occurrence of any of three characters.
+ */
+inline const char* findFirstOf(const char* pos, const char* end, char a,
+                               char b, char c) {
+#if defined(__AVX2__)
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+    while (end - pos >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)pos);
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, va),
+                            _mm256_cmpeq_epi8(chunk, vb)),
+            _mm256_cmpeq_epi8(chunk, vc));
+        unsigned mask = _mm256_movemask_epi8(hits);
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    while (end - pos >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)pos);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+                                                 _mm_cmpeq_epi8(chunk, vb)),
+                                    _mm_cmpeq_epi8(chunk, vc));
+        unsigned mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos != end && *pos != a && *pos != b && *pos != c) {
+        pos++;
+    }
+    return pos;
+}
+
+/**
+ * Finds the first occurrence of a character.
+ */
+inline const char* findChar(const char* pos, const char* end, char chr) {
+    // libc's memchr is already vectorised
+    const void* hit = memchr(pos, chr, end - pos);
+    return hit != nullptr ? static_cast<const char*>(hit) : end;
+}
+
+/**
+ * Finds the first character that is not a space, tab, or line break.
+ */
+inline const char* skipWhitespace(const char* pos, const char* end) {
+    // most whitespace runs are a single space; don't bother with the vector
+    // setup for those
+    if (pos != end && !isWhitespace(*pos)) {
+        return pos;
+    }
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i ret = _mm256_set1_epi8('\r');
+    while (end - pos >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)pos);
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                            _mm256_cmpeq_epi8(chunk, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline),
+                            _mm256_cmpeq_epi8(chunk, ret)));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(hits);
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i ret = _mm_set1_epi8('\r');
+    while (end - pos >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)pos);
+        __m128i hits =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                      _mm_cmpeq_epi8(chunk, tab)),
+                         _mm_or_si128(_mm_cmpeq_epi8(chunk, newline),
+                                      _mm_cmpeq_epi8(chunk, ret)));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(hits) & 0xFFFF;
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos != end && isWhitespace(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+
+} // namespace CharScan
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <charconv>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * Buffered sink for generated code.
+ *
+ * Output is accumulated in a contiguous buffer and only handed to the
+ * underlying stream once the buffer passes a size threshold, or when the
+ * emitter is explicitly flushed or destroyed.
+ */
+class CodeEmitter {
+public:
+    static constexpr size_t DEFAULT_FLUSH_THRESHOLD = 256 * 1024;
+
+    CodeEmitter(std::ostream& os,
+                size_t flushThreshold = DEFAULT_FLUSH_THRESHOLD)
+        : os(&os), flushThreshold(flushThreshold), bytesFlushed(0),
+          lineCount(0) {
+        buffer.reserve(flushThreshold + flushThreshold / 4);
+    }
+
+    CodeEmitter(const CodeEmitter&) = delete;
+    CodeEmitter& operator=(const CodeEmitter&) = delete;
+
+    ~CodeEmitter() { flush(); }
+
+    CodeEmitter& operator<<(std::string_view text) {
+        buffer.append(text.data(), text.size());
+        flushIfFull();
+        return *this;
+    }
+
+    CodeEmitter& operator<<(char chr) {
+        buffer.push_back(chr);
+        flushIfFull();
+        return *this;
+    }
+
+    template <class T,
+              typename = std::enable_if_t<std::is_integral<T>::value>>
+    CodeEmitter& operator<<(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr - digits);
+        flushIfFull();
+        return *this;
+    }
+
+    /**
+     * Ends the current line and indents the next one.
+     *
+     * @param indentLevel the number of indentation steps for the new line
+     */
+    void newLine(size_t indentLevel) {
+        buffer.push_back('\n');
+        lineCount++;
+
+        size_t width = indentLevel * INDENT_WIDTH;
+        if (width > indentation.size()) {
+            indentation.resize(width, ' ');
+        }
+        buffer.append(indentation.data(), width);
+        flushIfFull();
+    }
+
+    /**
+     * Writes all buffered output to the underlying stream.
+     */
+    void flush() {
+        if (!buffer.empty()) {
+            os->write(buffer.data(), buffer.size());
+            bytesFlushed += buffer.size();
+            buffer.clear();
+        }
+        os->flush();
+    }
+
+    /**
+     * Flushes all buffered output, then sends further output to another
+     * stream.
+     *
+     * @return the stream output was going to until now
+     */
+    std::ostream& redirect(std::ostream& stream) {
+        flush();
+        std::ostream& previous = *os;
+        os = &stream;
+        return previous;
+    }
+
+    /**
+     * Gets the total number of bytes emitted so far, flushed or not.
+     */
+    size_t getByteCount() const { return bytesFlushed + buffer.size(); }
+
+    /**
+     * Gets the number of line breaks emitted so far.
+     */
+    size_t getLineCount() const { return lineCount; }
+
+private:
+    static constexpr size_t INDENT_WIDTH = 4;
+
+    std::ostream* os;
+    std::string buffer;
+    size_t flushThreshold;
+    size_t bytesFlushed;
+    size_t lineCount;
+
+    // a run of spaces long enough for the deepest indentation seen so far
+    std::string indentation;
+
+    void flushIfFull() {
+        if (buffer.size() >= flushThreshold) {
+            os->write(buffer.data(), buffer.size());
+            bytesFlushed += buffer.size();
+            buffer.clear();
+        }
+    }
+};
@@ -0,0 +1,149 @@
+#include "CompileCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const ENTRY_EXTENSION = ".sh";
+
+struct Entry {
+    fs::path path;
+    uint64_t size;
+    fs::file_time_type lastUsed;
+};
+
+/**
+ * Lists the entries in a cache directory, skipping temporary files.
+ */
+std::vector<Entry> listEntries(const std::string& directory) {
+    std::vector<Entry> entries;
+    std::error_code err;
+    for (fs::directory_iterator it(directory, err), end; !err && it != end;
+         it.increment(err)) {
+        const fs::path& path = it->path();
+        if (path.extension() != ENTRY_EXTENSION) {
+            continue;
+        }
+
+        // another process may evict an entry while it is being listed
+        std::error_code statErr;
+        uint64_t size = fs::file_size(path, statErr);
+        auto lastUsed = fs::last_write_time(path, statErr);
+        if (!statErr) {
+            entries.push_back({path, size, lastUsed});
+        }
+    }
+    return entries;
+}
+
+} // namespace
+
+std::optional<std::string> CompileCache::load(const std::string& key) {
+    std::string path = getPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        misses++;
+        return std::nullopt;
+    }
+
+    std::string script{std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>()};
+    if (in.bad()) {
+        misses++;
+        return std::nullopt;
+    }
+
+    // mark the entry as recently used
+    std::error_code err;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), err);
+    hits++;
+    return script;
+}
+
+void CompileCache::store(const std::string& key, std::string_view script) {
+    std::error_code err;
+    fs::create_directories(directory, err);
+    if (err) {
+        return;
+    }
+
+    // write the entry under a name no other writer uses, then move it into
+    // place in one step
+    std::string path = getPath(key);
+    std::string tempPath = path + ".tmp." + std::to_string(getpid()) + "." +
+                           std::to_string(tempCount++);
+    {
+        std::ofstream out(tempPath, std::ios::binary);
+        out.write(script.data(), script.size());
+        out.close();
+        if (!out) {
+            fs::remove(tempPath, err);
+            return;
+        }
+    }
+    fs::rename(tempPath, path, err);
+    if (err) {
+        fs::remove(tempPath, err);
+        return;
+    }
+    stores++;
+
+    std::lock_guard<std::mutex> lock(sizeMutex);
+    if (!totalBytes) {
+        evict();
+    } else {
+        *totalBytes += script.size();
+        if (*totalBytes > maxBytes) {
+            evict();
+        }
+    }
+}
+
+CompileCache::Statistics CompileCache::getStatistics() const {
+    Statistics stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.stores = stores;
+    stats.evictions = evictions;
+    return stats;
+}
+
+std::string CompileCache::getPath(const std::string& key) const {
+    return (fs::path(directory) / (key + ENTRY_EXTENSION)).string();
+}
+
+void CompileCache::evict() {
+    std::vector<Entry> entries = listEntries(directory);
+
+    uint64_t total = 0;
+    for (const auto& entry : entries) {
+        total += entry.size;
+    }
+
+    if (total > maxBytes) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& lhs, const Entry& rhs) {
+                      return lhs.lastUsed < rhs.lastUsed;
+                  });
+        for (const auto& entry : entries) {
+            if (total <= maxBytes) {
+                break;
+            }
+            std::error_code err;
+            if (fs::remove(entry.path, err)) {
+                total -= entry.size;
+                evictions++;
+            }
+        }
+    }
+
+    totalBytes = total;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * On-disk cache of compiled scripts, addressed by a hash of everything a
+ * script depends on.
+ *
+ * Each entry is a file in the cache directory named after its key. Entries
+ * are written to a temporary file and renamed into place, so concurrent
+ * compilers, whether threads of one batch or separate processes, never see a
+ * partial entry. Reading an entry refreshes its modification time; once the
+ * cache grows past its size limit, the entries used least recently are
+ * evicted.
+ *
+ * A cache may be shared by the threads of a batch. Failing to read or write
+ * the cache is never an error, as the script can always be compiled afresh.
+ */
+class CompileCache {
+public:
+    /**
+     * Counts of cache operations since the cache was opened.
+     */
+    struct Statistics {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t stores = 0;
+        size_t evictions = 0;
+    };
+
+    static constexpr uint64_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+    /**
+     * @param directory the directory holding the entries, created on the
+     * first store if needed
+     * @param maxBytes the total size of entries to keep
+     */
+    CompileCache(std::string directory, uint64_t maxBytes = DEFAULT_MAX_BYTES)
+        : directory(std::move(directory)), maxBytes(maxBytes), hits(0),
+          misses(0), stores(0), evictions(0), tempCount(0) {}
+
+    /**
+     * Looks up the script stored under a key.
+     *
+     * @return the script, or nothing on a miss
+     */
+    std::optional<std::string> load(const std::string& key);
+
+    /**
+     * Stores a script under a key, evicting old entries as needed.
+     */
+    void store(const std::string& key, std::string_view script);
+
+    Statistics getStatistics() const;
+
+private:
+    std::string directory;
+    uint64_t maxBytes;
+
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> stores;
+    std::atomic<size_t> evictions;
+
+    // numbers the temporary files written by this process
+    std::atomic<size_t> tempCount;
+
+    // estimated size of the entries on disk, unknown until first needed
+    std::mutex sizeMutex;
+    std::optional<uint64_t> totalBytes;
+
+    std::string getPath(const std::string& key) const;
+
+    /**
+     * Removes the least recently used entries until the cache fits its
+     * limit, and recounts its size. Must be called with sizeMutex held.
+     */
+    void evict();
+};
@@ -0,0 +1,470 @@
+#include "CompileServer.h"
+#include "PunchException.h"
+#include "ThreadPool.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace CompileServer {
+
+namespace {
+
+// requests only name a file, so anything longer is not a request
+const size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+// most bytes of scripts kept in memory before the least recently used are
+// dropped
+const size_t MAX_RESULT_BYTES = 64 * 1024 * 1024;
+
+// longest a worker waits on a client that neither sends nor reads
+const time_t CLIENT_TIMEOUT_SECONDS = 10;
+
+const char* const OK_STATUS = "ok\n";
+const char* const ERROR_STATUS = "error\n";
+
+/**
+ * Owns a socket descriptor, closing it when done.
+ */
+class Socket {
+public:
+    explicit Socket(int fd) : fd(fd) {}
+
+    ~Socket() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    int get() const { return fd; }
+
+private:
+    int fd;
+};
+
+/**
+ * Fills in the address of a socket path.
+ *
+ * @return whether the path fits in an address
+ */
+bool makeAddress(const std::string& socketPath, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return true;
+}
+
+/**
+ * Connects to a listening socket.
+ *
+ * @return the connected descriptor, or -1 if nothing is listening
+ */
+int connectTo(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+        0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Writes all of a message to a socket.
+ *
+ * @return whether the whole message was sent
+ */
+bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        // a peer hanging up must not kill the process with SIGPIPE
+        ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(sent);
+    }
+    return true;
+}
+
+/**
+ * Reads from a socket until the peer stops sending.
+ *
+ * @param limit the most bytes to accept
+ * @return the data, or nothing if reading failed or passed the limit
+ */
+std::optional<std::string> receiveAll(int fd, size_t limit) {
+    std::string data;
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return std::nullopt;
+        }
+        if (received == 0) {
+            return data;
+        }
+        data.append(buffer, received);
+        if (data.size() > limit) {
+            return std::nullopt;
+        }
+    }
+}
+
+std::string writeOptions(const Driver::CompileOptions& options) {
+    std::stringstream out;
+    out << options.foldConstants << ' ' << options.inlineFunctions << ' '
+        << options.eliminateDeadCode << ' ' << options.hoistInvariants << ' '
+        << options.memoizeAll << ' ' << options.memoLimit << ' '
+        << options.astInput;
+    return out.str();
+}
+
+bool readOptions(const std::string& text, Driver::CompileOptions& options) {
+    std::stringstream in(text);
+    in >> options.foldConstants >> options.inlineFunctions >>
+        options.eliminateDeadCode >> options.hoistInvariants >>
+        options.memoizeAll >> options.memoLimit >> options.astInput;
+    return !in.fail() && (in >> std::ws).eof();
+}
+
+/**
+ * State shared by the workers of a server.
+ */
+class Server {
+public:
+    Server(CompileCache* cache) : cache(cache) {}
+
+    /**
+     * Answers a single request on a connected socket.
+     */
+    void handle(int fd) {
+        // a client that stalls must not hold on to a worker
+        timeval timeout{CLIENT_TIMEOUT_SECONDS, 0};
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                       sizeof(timeout)) != 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                       sizeof(timeout)) != 0) {
+            return;
+        }
+
+        auto request = receiveAll(fd, MAX_REQUEST_SIZE);
+        if (!request) {
+            return;
+        }
+
+        // the request is three lines: version, options and source path
+        std::stringstream lines(*request);
+        std::string version;
+        std::string optionsLine;
+        std::string path;
+        std::getline(lines, version);
+        std::getline(lines, optionsLine);
+        std::getline(lines, path);
+
+        // a client from another version gets no answer, and so compiles
+        // locally
+        Driver::CompileOptions options;
+        if (version != "punch " + std::string(Driver::VERSION) ||
+            !readOptions(optionsLine, options) || path.empty()) {
+            return;
+        }
+        options.cache = cache;
+        options.mapSources = false;
+
+        try {
+            std::string script = compile(path, optionsLine, options);
+            if (sendAll(fd, OK_STATUS)) {
+                sendAll(fd, script);
+            }
+        } catch (const PunchException& e) {
+            if (sendAll(fd, ERROR_STATUS)) {
+                sendAll(fd, PunchException::describe(e));
+            }
+        } catch (const std::exception& e) {
+            // anything else escaping a worker would take down the server
+            if (sendAll(fd, ERROR_STATUS)) {
+                sendAll(fd, std::string("Internal error: ") + e.what());
+            }
+        }
+    }
+
+private:
+    /**
+     * The state of a source file when it was compiled.
+     */
+    struct SourceState {
+        std::string path;
+        fs::file_time_type modified;
+        uintmax_t size;
+    };
+
+    struct Result {
+        std::vector<SourceState> sources;
+        std::string script;
+
+        // position of the key in the recency order
+        std::list<std::string>::iterator recency;
+    };
+
+    CompileCache* cache;
+
+    // results by request key, and their keys from most to least recently
+    // used
+    std::mutex resultsMutex;
+    std::unordered_map<std::string, Result> results;
+    std::list<std::string> recency;
+    size_t resultBytes = 0;
+
+    /**
+     * Notes the current state of a source file.
+     *
+     * @return whether the file could be inspected
+     */
+    static bool inspect(const std::string& path, SourceState& state) {
+        std::error_code err;
+        state.path = path;
+        state.modified = fs::last_write_time(path, err);
+        state.size = err ? 0 : fs::file_size(path, err);
+        return !err;
+    }
+
+    /**
+     * Checks whether none of the sources of a result have changed.
+     */
+    static bool isCurrent(const std::vector<SourceState>& sources) {
+        for (const auto& source : sources) {
+            SourceState state;
+            if (!inspect(source.path, state) ||
+                state.modified != source.modified ||
+                state.size != source.size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Compiles a source, reusing the last result for it if neither the
+     * source nor anything it imports has changed.
+     */
+    std::string compile(const std::string& path,
+                        const std::string& optionsLine,
+                        const Driver::CompileOptions& options) {
+        std::string key = optionsLine + '\n' + path;
+
+        // the sources are checked outside the lock, so other workers are
+        // not held up by the file system
+        std::optional<std::vector<SourceState>> sources;
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            auto pos = results.find(key);
+            if (pos != results.end()) {
+                sources = pos->second.sources;
+            }
+        }
+        if (sources && isCurrent(*sources)) {
+            // the result may have been dropped meanwhile, or replaced by a
+            // later one, which is just as current
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            auto pos = results.find(key);
+            if (pos != results.end()) {
+                recency.splice(recency.begin(), recency, pos->second.recency);
+                return pos->second.script;
+            }
+        }
+
+        // note the state of the source before reading it, so a change made
+        // while compiling is picked up by the next request
+        Result result;
+        result.sources.emplace_back();
+        if (!inspect(path, result.sources.back())) {
+            return Driver::compileScript(path, options);
+        }
+
+        auto started = fs::file_time_type::clock::now();
+        std::vector<std::string> imported;
+        result.script = Driver::compileScript(path, options, &imported);
+
+        // imported sources are only known once compiled, so a result is not
+        // kept if one of them may have changed in the meantime
+        for (const auto& importPath : imported) {
+            result.sources.emplace_back();
+            if (!inspect(importPath, result.sources.back()) ||
+                result.sources.back().modified >= started) {
+                return result.script;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        keep(key, result);
+        return result.script;
+    }
+
+    static size_t getSize(const std::string& key, const Result& result) {
+        return key.size() + result.script.size();
+    }
+
+    /**
+     * Keeps a result as the most recently used, dropping the least recently
+     * used results past the size limit. Must hold resultsMutex.
+     */
+    void keep(const std::string& key, const Result& result) {
+        auto pos = results.find(key);
+        if (pos != results.end()) {
+            resultBytes -= getSize(key, pos->second);
+            recency.erase(pos->second.recency);
+            results.erase(pos);
+        }
+
+        recency.push_front(key);
+        Result& kept = results[key];
+        kept = result;
+        kept.recency = recency.begin();
+        resultBytes += getSize(key, kept);
+
+        while (resultBytes > MAX_RESULT_BYTES && recency.size() > 1) {
+            auto oldest = results.find(recency.back());
+            resultBytes -= getSize(oldest->first, oldest->second);
+            results.erase(oldest);
+            recency.pop_back();
+        }
+    }
+};
+
+} // namespace
+
+void serve(const std::string& socketPath, size_t jobCount,
+           CompileCache* cache) {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        throw IOException("socket path '" + socketPath + "' is too long");
+    }
+
+    // a socket nothing listens on was left behind by a server that died
+    int existing = connectTo(socketPath);
+    if (existing >= 0) {
+        close(existing);
+        throw IOException("a server is already listening on '" + socketPath +
+                          "'");
+    }
+    std::error_code err;
+    if (fs::is_socket(socketPath, err)) {
+        fs::remove(socketPath, err);
+    }
+
+    // only the owner may connect, as requests name any file the server can
+    // read; nothing connects before listen, so the mode is set in time
+    Socket listener(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.get() < 0 ||
+        bind(listener.get(), reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+        listen(listener.get(), SOMAXCONN) != 0) {
+        throw IOException("cannot listen on '" + socketPath +
+                          "': " + strerror(errno));
+    }
+
+    Server server(cache);
+    ThreadPool pool(jobCount);
+    while (true) {
+        int fd = accept(listener.get(), nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            throw IOException("cannot accept on '" + socketPath +
+                              "': " + strerror(errno));
+        }
+        pool.submit([&server, fd]() {
+            Socket connection(fd);
+            server.handle(connection.get());
+        });
+    }
+}
+
+bool forward(const std::string& socketPath, const std::string& inFilename,
+             const std::string& outFilename,
+             const Driver::CompileOptions& options) {
+    // the server has its own working directory
+    std::error_code err;
+    fs::path path = fs::absolute(inFilename, err);
+    if (err || path.string().find('\n') != std::string::npos) {
+        return false;
+    }
+
+    Socket connection(connectTo(socketPath));
+    if (connection.get() < 0) {
+        return false;
+    }
+
+    std::string request = "punch " + std::string(Driver::VERSION) + "\n" +
+                          writeOptions(options) + "\n" + path.string() + "\n";
+    if (!sendAll(connection.get(), request) ||
+        shutdown(connection.get(), SHUT_WR) != 0) {
+        return false;
+    }
+
+    auto response = receiveAll(connection.get(), SIZE_MAX);
+    if (!response) {
+        return false;
+    }
+
+    std::string_view body = *response;
+    if (body.substr(0, strlen(ERROR_STATUS)) == ERROR_STATUS) {
+        body.remove_prefix(strlen(ERROR_STATUS));
+        throw RemoteException(std::string(body));
+    }
+    if (body.substr(0, strlen(OK_STATUS)) != OK_STATUS) {
+        return false;
+    }
+    body.remove_prefix(strlen(OK_STATUS));
+
+    // as with a local compile, the output is only opened once compiled
+    std::ofstream outFile;
+    if (!outFilename.empty()) {
+        outFile.open(outFilename);
+        if (!outFile) {
+            throw IOException("cannot write '" + outFilename + "'");
+        }
+    }
+    std::ostream& out = outFilename.empty() ? std::cout : outFile;
+    out << body << std::flush;
+    return true;
+}
+
+} // namespace CompileServer
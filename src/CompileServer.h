@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Driver.h"
+
+#include <string>
+
+/**
+ * Resident compile server, and the client side that forwards compilations to
+ * it.
+ *
+ * The server listens on a Unix domain socket and compiles each request on a
+ * thread pool, so build tools running many small compilations pay neither
+ * process startup nor a cold start per script. Compiled scripts stay in
+ * memory, keyed by source path and options, and are reused until the
+ * modification time or size of the source, or of a module it imports,
+ * changes. Once they pass a size limit, the scripts used least recently are
+ * dropped.
+ *
+ * A request carries the compiler version, the compile options and the
+ * absolute path of the source; the client writes the returned script itself,
+ * so the server never needs the client's working directory or permissions.
+ */
+namespace CompileServer {
+
+/**
+ * Serves compile requests on a socket until the process is stopped.
+ *
+ * A stale socket file left by a previous server is replaced.
+ *
+ * @param socketPath the path to listen on
+ * @param jobCount the number of worker threads; 0 means one per core
+ * @param cache the on-disk cache to compile through, or null for none
+ *
+ * @throws IOException if the socket cannot be set up, or another server is
+ * already listening on it
+ */
+void serve(const std::string& socketPath, size_t jobCount,
+           CompileCache* cache);
+
+/**
+ * Asks a running server to compile a source.
+ *
+ * @param socketPath the path the server listens on
+ * @param inFilename the path of the source
+ * @param outFilename the path to write the script to, or empty for stdout
+ * @param options the compilation settings; any cache is left to the server
+ * @return whether a server handled the request; if not, nothing was written
+ * and the source should be compiled locally
+ *
+ * @throws RemoteException if the server failed to compile the source
+ * @throws IOException if the script cannot be written
+ */
+bool forward(const std::string& socketPath, const std::string& inFilename,
+             const std::string& outFilename,
+             const Driver::CompileOptions& options);
+
+} // namespace CompileServer
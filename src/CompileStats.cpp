@@ -0,0 +1,222 @@
+#include "CompileStats.h"
+#include "AllocationCounter.h"
+#include "AstProgram.h"
+
+#include <iomanip>
+#include <iterator>
+
+#include <time.h>
+
+namespace {
+
+// names of the node kinds, in the order of AstKind
+const char* const KIND_NAMES[] = {
+    "Program", "FunctionDecl", "StatementBlock", "Assignment", "Return",
+    "SimpleConditional", "BranchingConditional", "ForLoop", "WhileLoop",
+    "Variable", "FunctionCall", "BinaryExpression", "NumberLiteral",
+    "StringLiteral", "RawBashExpression", "RawPunchExpression",
+    "RawEnvironment", "BinaryComparison", "Conjunction", "Disjunction",
+    "Negation", "True", "False",
+};
+
+static_assert(std::size(KIND_NAMES) ==
+              static_cast<size_t>(AstKind::False) + 1);
+
+/**
+ * Gets the CPU time used so far by the calling thread.
+ */
+double getThreadCpuSeconds() {
+    timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+        return 0;
+    }
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Checks whether a stage only repeats work timed as part of another stage,
+ * so it is reported but left out of the total. The scanner runs on its own
+ * purely for the statistics; the same scan is part of the parse.
+ */
+bool isInformational(const CompileStats::Stage& stage) {
+    return stage.name == "scan";
+}
+
+/**
+ * Counts every node below the nodes it is applied to.
+ */
+class NodeCounter : public AstNodeMapper {
+public:
+    NodeCounter(size_t* counts) : counts(counts) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        counts[static_cast<size_t>(node->getKind())]++;
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    size_t* counts;
+};
+
+} // namespace
+
+CompileStats::Timer::Timer(CompileStats* stats, std::string_view name)
+    : stats(stats), name(name) {
+    if (stats != nullptr) {
+        allocationsStart = AllocationCounter::getCount();
+        bytesStart = AllocationCounter::getBytes();
+        cpuStart = getThreadCpuSeconds();
+        wallStart = std::chrono::steady_clock::now();
+    }
+}
+
+CompileStats::Timer::~Timer() {
+    if (stats != nullptr) {
+        std::chrono::duration<double> wall =
+            std::chrono::steady_clock::now() - wallStart;
+        double cpu = getThreadCpuSeconds() - cpuStart;
+        stats->addStage(name, wall.count(), cpu,
+                        AllocationCounter::getCount() - allocationsStart,
+                        AllocationCounter::getBytes() - bytesStart);
+    }
+}
+
+void CompileStats::addSource(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sourceCount++;
+    sourceBytes += bytes;
+}
+
+void CompileStats::addTokens(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tokenCount += count;
+}
+
+void CompileStats::addNodes(AstProgram* program) {
+    // count outside the lock, then merge
+    std::array<size_t, KIND_COUNT> counts{};
+    counts[static_cast<size_t>(program->getKind())]++;
+    program->apply(NodeCounter(counts.data()));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+        nodeCounts[i] += counts[i];
+    }
+}
+
+void CompileStats::addEmitted(size_t bytes, size_t lines) {
+    std::lock_guard<std::mutex> lock(mutex);
+    emittedBytes += bytes;
+    emittedLines += lines;
+}
+
+void CompileStats::addStage(std::string_view name, double wallSeconds,
+                            double cpuSeconds, size_t allocations,
+                            size_t allocatedBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto pos = stages.begin();
+    while (pos != stages.end() && pos->name != name) {
+        ++pos;
+    }
+    if (pos == stages.end()) {
+        pos = stages.insert(pos, Stage());
+        pos->name = name;
+    }
+    pos->runs++;
+    pos->wallSeconds += wallSeconds;
+    pos->cpuSeconds += cpuSeconds;
+    pos->allocations += allocations;
+    pos->allocatedBytes += allocatedBytes;
+}
+
+void CompileStats::print(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    Stage total;
+    total.name = "total";
+    out << std::left << std::setw(12) << "stage" << std::right
+        << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms"
+        << std::setw(12) << "allocs" << std::setw(14) << "alloc bytes"
+        << std::endl;
+    auto printStage = [&out](const Stage& stage) {
+        out << std::left << std::setw(12) << stage.name << std::right
+            << std::fixed << std::setprecision(3) << std::setw(12)
+            << stage.wallSeconds * 1e3 << std::setw(12)
+            << stage.cpuSeconds * 1e3 << std::setw(12) << stage.allocations
+            << std::setw(14) << stage.allocatedBytes << std::endl;
+    };
+    bool informational = false;
+    for (const auto& stage : stages) {
+        printStage(stage);
+        if (isInformational(stage)) {
+            informational = true;
+        } else {
+            total.add(stage);
+        }
+    }
+    printStage(total);
+    if (informational) {
+        out << "(scan is also timed within parse, so it is not in the total)"
+            << std::endl;
+    }
+
+    out << std::endl;
+    out << "sources: " << sourceCount << " (" << sourceBytes << " bytes)"
+        << std::endl;
+    out << "tokens:  " << tokenCount << std::endl;
+    out << "emitted: " << emittedBytes << " bytes, " << emittedLines
+        << " lines" << std::endl;
+
+    size_t nodeTotal = 0;
+    for (size_t count : nodeCounts) {
+        nodeTotal += count;
+    }
+    out << "nodes:   " << nodeTotal << std::endl;
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+        if (nodeCounts[i] != 0) {
+            out << "  " << std::left << std::setw(22) << KIND_NAMES[i]
+                << std::right << std::setw(10) << nodeCounts[i] << std::endl;
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void CompileStats::printJson(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stage total;
+    auto printStage = [&out](const Stage& stage) {
+        out << "\"wall_ms\": " << stage.wallSeconds * 1e3
+            << ", \"cpu_ms\": " << stage.cpuSeconds * 1e3
+            << ", \"allocations\": " << stage.allocations
+            << ", \"allocated_bytes\": " << stage.allocatedBytes;
+    };
+    out << "{\"stages\": [";
+    for (size_t i = 0; i < stages.size(); i++) {
+        const Stage& stage = stages[i];
+        out << (i == 0 ? "" : ", ") << "{\"name\": \"" << stage.name
+            << "\", \"runs\": " << stage.runs << ", ";
+        printStage(stage);
+        out << ", \"in_total\": "
+            << (isInformational(stage) ? "false" : "true") << "}";
+        if (!isInformational(stage)) {
+            total.add(stage);
+        }
+    }
+    out << "], \"total\": {";
+    printStage(total);
+    out << "}, \"sources\": " << sourceCount
+        << ", \"source_bytes\": " << sourceBytes
+        << ", \"tokens\": " << tokenCount << ", \"nodes\": {";
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+        out << (i == 0 ? "" : ", ") << "\"" << KIND_NAMES[i]
+            << "\": " << nodeCounts[i];
+    }
+    out << "}, \"emitted_bytes\": " << emittedBytes
+        << ", \"emitted_lines\": " << emittedLines << "}" << std::endl;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "AstNode.h"
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class AstProgram;
+
+/**
+ * Measurements of where compilation spends its time and memory, as reported
+ * by --stats.
+ *
+ * Each stage records its wall and CPU time and the heap allocations made
+ * while it ran. Figures are summed over everything compiled with the same
+ * statistics, such as the modules a program imports or the sources of a
+ * batch. Time and allocations are measured on the thread running the stage,
+ * so stages running concurrently in a batch do not count each other's work.
+ *
+ * Statistics may be shared by the threads of a batch.
+ */
+class CompileStats {
+public:
+    /**
+     * Totals of a single stage.
+     */
+    struct Stage {
+        std::string name;
+        size_t runs = 0;
+        double wallSeconds = 0;
+        double cpuSeconds = 0;
+        size_t allocations = 0;
+        size_t allocatedBytes = 0;
+
+        /**
+         * Adds the measurements of another stage to these.
+         */
+        void add(const Stage& other) {
+            wallSeconds += other.wallSeconds;
+            cpuSeconds += other.cpuSeconds;
+            allocations += other.allocations;
+            allocatedBytes += other.allocatedBytes;
+        }
+    };
+
+    /**
+     * Measures a stage over its own lifetime, recording it on destruction.
+     */
+    class Timer {
+    public:
+        /**
+         * @param stats the statistics to record into; if null, nothing is
+         * measured
+         * @param name the name of the stage
+         */
+        Timer(CompileStats* stats, std::string_view name);
+
+        ~Timer();
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        CompileStats* stats;
+        std::string_view name;
+        std::chrono::steady_clock::time_point wallStart;
+        double cpuStart = 0;
+        size_t allocationsStart = 0;
+        size_t bytesStart = 0;
+    };
+
+    /**
+     * Records a source read in.
+     */
+    void addSource(size_t bytes);
+
+    /**
+     * Records the tokens scanned from a source.
+     */
+    void addTokens(size_t count);
+
+    /**
+     * Records the nodes of a program, counted by kind.
+     */
+    void addNodes(AstProgram* program);
+
+    /**
+     * Records code emitted by the translator.
+     */
+    void addEmitted(size_t bytes, size_t lines);
+
+    /**
+     * Writes a human-readable report.
+     */
+    void print(std::ostream& out) const;
+
+    /**
+     * Writes the report as a single JSON object.
+     */
+    void printJson(std::ostream& out) const;
+
+private:
+    static constexpr size_t KIND_COUNT =
+        static_cast<size_t>(AstKind::False) + 1;
+
+    mutable std::mutex mutex;
+
+    // in the order each stage first ran
+    std::vector<Stage> stages;
+
+    size_t sourceCount = 0;
+    size_t sourceBytes = 0;
+    size_t tokenCount = 0;
+    std::array<size_t, KIND_COUNT> nodeCounts{};
+    size_t emittedBytes = 0;
+    size_t emittedLines = 0;
+
+    void addStage(std::string_view name, double wallSeconds,
+                  double cpuSeconds, size_t allocations,
+                  size_t allocatedBytes);
+};
@@ -0,0 +1,118 @@
+#include "ConstantFolder.h"
+#include "AstUtils.h"
+
+#include <limits>
+
+namespace {
+
+bool isNumber(const AstExpression* expr, int64_t value) {
+    const auto* lit = dyn_cast<AstNumberLiteral>(expr);
+    return lit != nullptr && lit->getNumber() == value;
+}
+
+} // namespace
+
+AstNode* ConstantFolder::mapNode(AstNode* node) const {
+    if (auto* expr = dyn_cast<AstBinaryExpression>(node)) {
+        return fold(expr, false);
+    }
+    node->apply(*this);
+    return node;
+}
+
+std::optional<int64_t> ConstantFolder::evaluate(BinaryOperator op,
+                                                int64_t lhs, int64_t rhs) {
+    // bash arithmetic wraps around, so compute without signed overflow
+    auto ulhs = static_cast<uint64_t>(lhs);
+    auto urhs = static_cast<uint64_t>(rhs);
+    constexpr int64_t MIN = std::numeric_limits<int64_t>::min();
+
+    switch (op) {
+    case BinaryOperator::ADD: return static_cast<int64_t>(ulhs + urhs);
+    case BinaryOperator::SUB: return static_cast<int64_t>(ulhs - urhs);
+    case BinaryOperator::MUL: return static_cast<int64_t>(ulhs * urhs);
+    case BinaryOperator::DIV:
+        // division by zero is a runtime error in bash
+        if (rhs == 0) {
+            return std::nullopt;
+        }
+        // bash special-cases the one quotient that overflows
+        if (lhs == MIN && rhs == -1) {
+            return MIN;
+        }
+        return lhs / rhs;
+    case BinaryOperator::MOD:
+        if (rhs == 0) {
+            return std::nullopt;
+        }
+        if (lhs == MIN && rhs == -1) {
+            return 0;
+        }
+        return lhs % rhs;
+    }
+
+    assert(false && "unexpected binary operator");
+    return std::nullopt;
+}
+
+AstExpression* ConstantFolder::fold(AstExpression* expr,
+                                    bool arithmetic) const {
+    auto* binary = dyn_cast<AstBinaryExpression>(expr);
+    if (binary == nullptr) {
+        return cast<AstExpression>(mapNode(expr));
+    }
+
+    // operands are always evaluated as part of this expression
+    AstExpression* lhs = fold(binary->getLHS(), true);
+    AstExpression* rhs = fold(binary->getRHS(), true);
+    binary->setLHS(lhs);
+    binary->setRHS(rhs);
+
+    BinaryOperator op = binary->getOperator();
+    const auto* lhsLit = dyn_cast<AstNumberLiteral>(lhs);
+    const auto* rhsLit = dyn_cast<AstNumberLiteral>(rhs);
+    if (lhsLit != nullptr && rhsLit != nullptr) {
+        if (auto value = evaluate(op, lhsLit->getNumber(), rhsLit->getNumber())) {
+            return arena.create<AstNumberLiteral>(*value);
+        }
+        return binary;
+    }
+
+    // x * 0, 0 * x and x % 1 are 0 whatever x is, as long as evaluating x
+    // has no visible effect and cannot fail on a division by zero
+    bool zeroProduct = op == BinaryOperator::MUL &&
+                       ((isNumber(lhs, 0) && AstUtils::isTotal(rhs)) ||
+                        (isNumber(rhs, 0) && AstUtils::isTotal(lhs)));
+    bool unitRemainder = op == BinaryOperator::MOD && isNumber(rhs, 1) &&
+                         AstUtils::isTotal(lhs);
+    if (zeroProduct || unitRemainder) {
+        return arena.create<AstNumberLiteral>(0);
+    }
+
+    // the remaining identities leave an operand in place of the expression
+    AstExpression* operand = nullptr;
+    switch (op) {
+    case BinaryOperator::ADD:
+        operand = isNumber(rhs, 0) ? lhs : isNumber(lhs, 0) ? rhs : nullptr;
+        break;
+    case BinaryOperator::SUB:
+        operand = isNumber(rhs, 0) ? lhs : nullptr;
+        break;
+    case BinaryOperator::MUL:
+        operand = isNumber(rhs, 1) ? lhs : isNumber(lhs, 1) ? rhs : nullptr;
+        break;
+    case BinaryOperator::DIV:
+        operand = isNumber(rhs, 1) ? lhs : nullptr;
+        break;
+    case BinaryOperator::MOD: break;
+    }
+    if (operand != nullptr && (arithmetic || isArithmetic(operand))) {
+        return operand;
+    }
+
+    return binary;
+}
+
+bool ConstantFolder::isArithmetic(const AstExpression* expr) {
+    return isa<AstNumberLiteral>(expr) || isa<AstBinaryExpression>(expr);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "AstArena.h"
+#include "AstNode.h"
+#include "AstProgram.h"
+
+#include <optional>
+
+/**
+ * AST pass folding constant arithmetic before translation.
+ *
+ * Binary expressions over number literals are evaluated the way bash would
+ * evaluate them at runtime, using wrapping 64-bit arithmetic. Divisions that
+ * would fail at runtime are left alone so that the script still fails the
+ * same way.
+ *
+ * Simple algebraic identities are applied as well. An identity that drops an
+ * operand (x * 0) is only applied if the operand has no side effects, and one
+ * that replaces the expression by an operand (x * 1, x + 0) is only applied
+ * where the result is evaluated arithmetically anyway, since a bare operand
+ * need not hold a number.
+ */
+class ConstantFolder : public AstNodeMapper {
+public:
+    /**
+     * @param arena the arena the program was allocated in, to hold any new
+     * nodes
+     */
+    ConstantFolder(AstArena& arena) : arena(arena) {}
+
+    /**
+     * Folds every expression in the program, in place.
+     */
+    void run(AstProgram* program) { program->apply(*this); }
+
+    AstNode* mapNode(AstNode* node) const override;
+
+    /**
+     * Evaluates a binary operator the way bash does.
+     *
+     * @return the result, or nothing if bash would fail to evaluate it
+     */
+    static std::optional<int64_t> evaluate(BinaryOperator op, int64_t lhs,
+                                           int64_t rhs);
+
+private:
+    AstArena& arena;
+
+    /**
+     * Folds an expression and all its subexpressions.
+     *
+     * @param expr the expression to fold
+     * @param arithmetic whether the result is only ever evaluated as part of
+     * an enclosing arithmetic expression
+     * @return the folded expression
+     */
+    AstExpression* fold(AstExpression* expr, bool arithmetic) const;
+
+    /**
+     * Checks whether an expression always produces an arithmetic result.
+     */
+    static bool isArithmetic(const AstExpression* expr);
+};
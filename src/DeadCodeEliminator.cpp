@@ -0,0 +1,294 @@
+#include "DeadCodeEliminator.h"
+#include "AstUtils.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using FunctionMap =
+    std::unordered_map<std::string_view, std::vector<AstFunctionDecl*>>;
+
+/**
+ * Collects the names of the functions a piece of code may call.
+ */
+class ReferenceCollector : public AstNodeMapper {
+public:
+    ReferenceCollector(const FunctionMap& functions,
+                       std::vector<std::string_view>& references)
+        : functions(functions), references(references) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* call = dyn_cast<AstFunctionCall>(node)) {
+            references.push_back(call->getName());
+        } else if (const auto* raw = dyn_cast<AstRawBashExpression>(node)) {
+            // raw code may call any function it names
+            for (auto word : AstUtils::findWords(raw->getExpression())) {
+                if (functions.count(word) != 0) {
+                    references.push_back(word);
+                }
+            }
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    const FunctionMap& functions;
+    std::vector<std::string_view>& references;
+};
+
+bool isSideEffectFree(const AstCondition* cond) {
+    switch (cond->getKind()) {
+    case AstKind::Conjunction: {
+        const auto* conj = cast<AstConjunction>(cond);
+        return isSideEffectFree(conj->getLHS()) &&
+               isSideEffectFree(conj->getRHS());
+    }
+    case AstKind::Disjunction: {
+        const auto* disj = cast<AstDisjunction>(cond);
+        return isSideEffectFree(disj->getLHS()) &&
+               isSideEffectFree(disj->getRHS());
+    }
+    case AstKind::Negation:
+        return isSideEffectFree(cast<AstNegation>(cond)->getCondition());
+    case AstKind::BinaryComparison: {
+        const auto* comp = cast<AstBinaryComparison>(cond);
+        return AstUtils::isSideEffectFree(comp->getLHS()) &&
+               AstUtils::isSideEffectFree(comp->getRHS());
+    }
+    default: return true;
+    }
+}
+
+} // namespace
+
+void DeadCodeEliminator::run(AstProgram* program) {
+    program->apply(*this);
+    if (!exported) {
+        removeUnreachableFunctions(program);
+    }
+}
+
+AstNode* DeadCodeEliminator::mapNode(AstNode* node) const {
+    node->apply(*this);
+
+    if (auto* function = dyn_cast<AstFunctionDecl>(node)) {
+        simplifyStatements(function->getStatements());
+    } else if (auto* block = dyn_cast<AstStatementBlock>(node)) {
+        simplifyStatements(block->getStatements());
+    } else if (auto* conditional = dyn_cast<AstConditional>(node)) {
+        return simplifyConditional(conditional);
+    } else if (auto* loop = dyn_cast<AstLoop>(node)) {
+        return simplifyLoop(loop);
+    }
+    return node;
+}
+
+std::optional<bool> DeadCodeEliminator::evaluate(const AstCondition* cond) {
+    switch (cond->getKind()) {
+    case AstKind::True: return true;
+    case AstKind::False: return false;
+    case AstKind::Negation: {
+        auto value = evaluate(cast<AstNegation>(cond)->getCondition());
+        return value ? std::optional<bool>(!*value) : std::nullopt;
+    }
+    case AstKind::Conjunction: {
+        // a false left operand decides the result without running the right
+        const auto* conj = cast<AstConjunction>(cond);
+        auto lhs = evaluate(conj->getLHS());
+        if (lhs && !*lhs) {
+            return false;
+        }
+        // otherwise both operands are needed, unless the right is false and
+        // skipping the left changes nothing
+        auto rhs = evaluate(conj->getRHS());
+        if (rhs && !*rhs && isSideEffectFree(conj->getLHS())) {
+            return false;
+        }
+        return lhs ? rhs : std::nullopt;
+    }
+    case AstKind::Disjunction: {
+        const auto* disj = cast<AstDisjunction>(cond);
+        auto lhs = evaluate(disj->getLHS());
+        if (lhs && *lhs) {
+            return true;
+        }
+        auto rhs = evaluate(disj->getRHS());
+        if (rhs && *rhs && isSideEffectFree(disj->getLHS())) {
+            return true;
+        }
+        return lhs ? rhs : std::nullopt;
+    }
+    case AstKind::BinaryComparison: {
+        const auto* comp = cast<AstBinaryComparison>(cond);
+        const auto* lhs = dyn_cast<AstNumberLiteral>(comp->getLHS());
+        const auto* rhs = dyn_cast<AstNumberLiteral>(comp->getRHS());
+        if (lhs == nullptr || rhs == nullptr) {
+            return std::nullopt;
+        }
+        int64_t l = lhs->getNumber();
+        int64_t r = rhs->getNumber();
+        switch (comp->getOperator()) {
+        case ComparisonOperator::LT: return l < r;
+        case ComparisonOperator::LE: return l <= r;
+        case ComparisonOperator::GT: return l > r;
+        case ComparisonOperator::GE: return l >= r;
+        case ComparisonOperator::EQ: return l == r;
+        case ComparisonOperator::NE: return l != r;
+        }
+        return std::nullopt;
+    }
+    default: return std::nullopt;
+    }
+}
+
+void DeadCodeEliminator::simplifyStatements(
+    AstList<AstStatement*>& stmts) const {
+    std::vector<AstStatement*> result;
+    bool returned = false;
+    for (auto* stmt : stmts) {
+        // blocks introduce no scope in bash, so their contents can be
+        // spliced into the enclosing list
+        if (auto* block = dyn_cast<AstStatementBlock>(stmt)) {
+            for (auto* inner : block->getStatements()) {
+                result.push_back(inner);
+                returned = alwaysReturns(inner);
+                if (returned) {
+                    break;
+                }
+            }
+        } else {
+            result.push_back(stmt);
+            returned = alwaysReturns(stmt);
+        }
+        if (returned) {
+            break;
+        }
+    }
+
+    stmts.clear();
+    for (auto* stmt : result) {
+        stmts.push_back(stmt);
+    }
+}
+
+AstStatement* DeadCodeEliminator::simplifyConditional(
+    AstConditional* conditional) const {
+    AstCondition* cond = conditional->getCondition();
+    auto value = evaluate(cond);
+
+    if (auto* simple = dyn_cast<AstSimpleConditional>(conditional)) {
+        if (value) {
+            return *value ? simple->getIfBranch()
+                          : arena.create<AstStatementBlock>(arena);
+        }
+        if (isEmptyBlock(simple->getIfBranch()) && isSideEffectFree(cond)) {
+            return simple->getIfBranch();
+        }
+        return simple;
+    }
+
+    auto* branching = cast<AstBranchingConditional>(conditional);
+    if (value) {
+        return *value ? branching->getIfBranch() : branching->getElseBranch();
+    }
+
+    // an emptied branch leaves nothing for bash to run there, which it
+    // would reject
+    bool emptyIf = isEmptyBlock(branching->getIfBranch());
+    bool emptyElse = isEmptyBlock(branching->getElseBranch());
+    if (emptyElse) {
+        return simplifyConditional(arena.create<AstSimpleConditional>(
+            cond, branching->getIfBranch()));
+    }
+    if (emptyIf) {
+        return arena.create<AstSimpleConditional>(
+            arena.create<AstNegation>(cond), branching->getElseBranch());
+    }
+    return branching;
+}
+
+AstStatement* DeadCodeEliminator::simplifyLoop(AstLoop* loop) const {
+    auto value = evaluate(loop->getCondition());
+    if (!value || *value) {
+        return loop;
+    }
+
+    // the initializer of a for loop still runs once
+    if (auto* forLoop = dyn_cast<AstForLoop>(loop)) {
+        return forLoop->getInit();
+    }
+    return arena.create<AstStatementBlock>(arena);
+}
+
+void DeadCodeEliminator::removeUnreachableFunctions(
+    AstProgram* program) const {
+    FunctionMap functions;
+    for (auto* function : program->getFunctions()) {
+        functions[function->getName()].push_back(function);
+    }
+
+    // everything the program runs at startup is a root
+    std::vector<std::string_view> worklist = {"main"};
+    ReferenceCollector collector(functions, worklist);
+    for (auto* assignment : program->getAssignments()) {
+        assignment->apply(collector);
+    }
+
+    std::unordered_set<std::string_view> reachable;
+    while (!worklist.empty()) {
+        std::string_view name = worklist.back();
+        worklist.pop_back();
+        if (!reachable.insert(name).second) {
+            continue;
+        }
+
+        auto pos = functions.find(name);
+        if (pos != functions.end()) {
+            for (auto* function : pos->second) {
+                function->apply(collector);
+            }
+        }
+    }
+
+    auto& list = program->getFunctions();
+    std::vector<AstFunctionDecl*> kept;
+    for (auto* function : list) {
+        if (reachable.count(function->getName()) != 0) {
+            kept.push_back(function);
+        }
+    }
+    list.clear();
+    for (auto* function : kept) {
+        list.push_back(function);
+    }
+}
+
+bool DeadCodeEliminator::alwaysReturns(const AstStatement* stmt) {
+    switch (stmt->getKind()) {
+    case AstKind::Return: return true;
+    case AstKind::StatementBlock: {
+        for (const auto* inner :
+             cast<AstStatementBlock>(stmt)->getStatements()) {
+            if (alwaysReturns(inner)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    case AstKind::BranchingConditional: {
+        const auto* branching = cast<AstBranchingConditional>(stmt);
+        return alwaysReturns(branching->getIfBranch()) &&
+               alwaysReturns(branching->getElseBranch());
+    }
+    default: return false;
+    }
+}
+
+bool DeadCodeEliminator::isEmptyBlock(const AstStatement* stmt) {
+    const auto* block = dyn_cast<AstStatementBlock>(stmt);
+    return block != nullptr && block->getStatements().empty();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "AstArena.h"
+#include "AstNode.h"
+#include "AstProgram.h"
+
+#include <optional>
+
+/**
+ * AST pass removing code that can never run.
+ *
+ * Within each function, statements following a return are dropped, and a
+ * conditional whose condition is constant is replaced by the branch that is
+ * taken. A loop whose condition is false from the start never runs its body.
+ * Functions that cannot be reached from main or from the global initializers
+ * are then removed altogether, unless the program is a module whose
+ * functions may be called from other modules.
+ *
+ * Raw bash code may call functions by name, so any word in raw code that
+ * names a function is treated as a call to it.
+ */
+class DeadCodeEliminator : public AstNodeMapper {
+public:
+    /**
+     * @param arena the arena the program was allocated in
+     * @param exported whether every function may be called from outside the
+     * program, and so must be kept
+     */
+    DeadCodeEliminator(AstArena& arena, bool exported = false)
+        : arena(arena), exported(exported) {}
+
+    /**
+     * Removes dead code from the program, in place.
+     */
+    void run(AstProgram* program);
+
+    AstNode* mapNode(AstNode* node) const override;
+
+    /**
+     * Evaluates a condition at compile time, where possible.
+     *
+     * @return the value of the condition, or nothing if it depends on the
+     * state of the program
+     */
+    static std::optional<bool> evaluate(const AstCondition* cond);
+
+private:
+    AstArena& arena;
+    bool exported;
+
+    /**
+     * Simplifies a statement list whose statements have already been
+     * simplified, splicing in the taken branches of constant conditionals
+     * and dropping everything after a return.
+     */
+    void simplifyStatements(AstList<AstStatement*>& stmts) const;
+
+    /**
+     * Simplifies a conditional appearing outside a statement list.
+     *
+     * @return the replacement statement, which is an empty block if nothing
+     * is left
+     */
+    AstStatement* simplifyConditional(AstConditional* conditional) const;
+
+    /**
+     * Simplifies a loop appearing outside a statement list.
+     *
+     * @return the replacement statement
+     */
+    AstStatement* simplifyLoop(AstLoop* loop) const;
+
+    /**
+     * Removes the functions that can never be called.
+     */
+    void removeUnreachableFunctions(AstProgram* program) const;
+
+    /**
+     * Checks whether execution never continues past a statement.
+     */
+    static bool alwaysReturns(const AstStatement* stmt);
+
+    /**
+     * Checks whether a statement is a block without any statements.
+     */
+    static bool isEmptyBlock(const AstStatement* stmt);
+};
@@ -0,0 +1,470 @@
+#include "Driver.h"
+#include "AstArena.h"
+#include "AstBinary.h"
+#include "CodeEmitter.h"
+#include "CompileCache.h"
+#include "CompileStats.h"
+#include "ConstantFolder.h"
+#include "DeadCodeEliminator.h"
+#include "Inliner.h"
+#include "Linker.h"
+#include "LoopInvariantHoister.h"
+#include "Memoizer.h"
+#include "ObjectModule.h"
+#include "Parser.h"
+#include "PunchException.h"
+#include "Scanner.h"
+#include "Sha256.h"
+#include "SourceBuffer.h"
+#include "ThreadPool.h"
+#include "Translator.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace Driver {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Computes the cache key of a source: a hash of everything its script
+ * depends on.
+ */
+std::string getCacheKey(std::string_view source,
+                        const CompileOptions& options) {
+    std::stringstream settings;
+    settings << options.foldConstants << options.inlineFunctions
+             << options.eliminateDeadCode << options.hoistInvariants
+             << options.memoizeAll << options.astInput << ' '
+             << options.memoLimit;
+
+    // separate the parts, so no two different inputs hash the same text
+    const std::string_view separator("\0", 1);
+    Sha256 hash;
+    hash.update(VERSION);
+    hash.update(separator);
+    hash.update(settings.str());
+    hash.update(separator);
+    hash.update(source);
+    return hash.hexDigest();
+}
+
+/**
+ * Opens the file to write a script to, or returns stdout if none is given.
+ */
+std::ostream& openOutput(const std::string& outFilename,
+                         std::ofstream& outFile) {
+    if (outFilename.empty()) {
+        return std::cout;
+    }
+    outFile.open(outFilename);
+    if (!outFile) {
+        throw IOException("cannot write '" + outFilename + "'");
+    }
+    return outFile;
+}
+
+/**
+ * Maps or reads in a source, noting it in the statistics.
+ */
+std::unique_ptr<SourceBuffer> openSource(const std::string& filename,
+                                         const CompileOptions& options) {
+    CompileStats::Timer timer(options.stats, "read");
+    auto source = SourceBuffer::open(filename, options.mapSources);
+    if (options.stats != nullptr) {
+        options.stats->addSource(source->getText().size());
+    }
+    return source;
+}
+
+/**
+ * Reads the program in a source, scanning and parsing it unless it is an
+ * encoded AST.
+ */
+AstProgram* readProgram(const SourceBuffer& source, AstArena& arena,
+                        const CompileOptions& options) {
+    CompileStats* stats = options.stats;
+    AstProgram* program;
+    if (options.astInput) {
+        CompileStats::Timer timer(stats, "decode");
+        program = AstBinary::read(source.getText(), arena, source.getName());
+    } else {
+        // the parser pulls tokens from the scanner on demand, so for the
+        // statistics the scanner is also timed on its own
+        if (stats != nullptr) {
+            CompileStats::Timer timer(stats, "scan");
+            Scanner scanner(source.getText());
+            size_t tokens = 0;
+            while (scanner.next().type != TokenType::END) {
+                tokens++;
+            }
+            stats->addTokens(tokens);
+        }
+
+        CompileStats::Timer timer(stats, "parse");
+
+        // run the scanner directly over the source
+        Scanner scanner(source.getText());
+
+        // run the parser, allocating the AST in the given arena
+        Parser parser(scanner, arena);
+        program = parser.parse();
+    }
+
+    if (stats != nullptr) {
+        stats->addNodes(program);
+    }
+    return program;
+}
+
+/**
+ * Reads and simplifies a source.
+ *
+ * @param source the source, which must outlive the program
+ * @param arena the arena to allocate the program in
+ * @param options the compilation settings
+ * @param module whether the source is compiled as a module, whose functions
+ * may be called from other modules; a source that imports modules is always
+ * compiled as one
+ * @return the program, ready to translate
+ */
+AstProgram* buildProgram(const SourceBuffer& source, AstArena& arena,
+                         const CompileOptions& options, bool module = false) {
+    AstProgram* program = readProgram(source, arena, options);
+
+    // simplify the program before translating it; inlining first exposes
+    // more constants to fold
+    CompileStats* stats = options.stats;
+    if (options.inlineFunctions) {
+        CompileStats::Timer timer(stats, "inline");
+        Inliner(arena).run(program);
+    }
+    if (options.foldConstants) {
+        CompileStats::Timer timer(stats, "fold");
+        ConstantFolder(arena).run(program);
+    }
+    if (options.eliminateDeadCode) {
+        CompileStats::Timer timer(stats, "dce");
+        bool exported = module || !program->getImports().empty();
+        DeadCodeEliminator(arena, exported).run(program);
+    }
+    // hoisting after dead code is gone leaves no invariant computed for a
+    // loop that was dropped
+    if (options.hoistInvariants) {
+        CompileStats::Timer timer(stats, "hoist");
+        LoopInvariantHoister(arena).run(program);
+    }
+    {
+        CompileStats::Timer timer(stats, "memoize");
+        Memoizer(options.memoizeAll).run(program);
+    }
+    return program;
+}
+
+/**
+ * Translates a program into a stream through a buffered emitter.
+ */
+void translateProgram(AstProgram* program, std::ostream& out,
+                      const CompileOptions& options) {
+    CompileStats::Timer timer(options.stats, "translate");
+    CodeEmitter emitter(out);
+    Translator translator(emitter, program, options.memoLimit);
+    translator.run();
+    if (options.stats != nullptr) {
+        options.stats->addEmitted(emitter.getByteCount(),
+                                 emitter.getLineCount());
+    }
+}
+
+/**
+ * Translates a program as a module to be linked with others.
+ *
+ * @param name the path of the source, for diagnostics
+ */
+ObjectModule translateModule(AstProgram* program, const std::string& name,
+                             const CompileOptions& options) {
+    CompileStats::Timer timer(options.stats, "translate");
+    ObjectModule module;
+    module.name = name;
+
+    // the translator takes each part out of the emitter itself
+    std::stringstream unused;
+    CodeEmitter emitter(unused);
+    Translator translator(emitter, program, options.memoLimit);
+    translator.runModule(module);
+    if (options.stats != nullptr) {
+        options.stats->addEmitted(emitter.getByteCount(),
+                                 emitter.getLineCount());
+    }
+    return module;
+}
+
+/**
+ * Compiles the modules imported by a module, and by those in turn, each only
+ * once.
+ *
+ * @param module the importing module
+ * @param directory the directory its imports are relative to
+ * @param seen the canonical paths of the modules compiled so far
+ * @param modules the list to add the compiled modules to, each after the
+ * modules it imports
+ * @param imported if not null, the list to add the path of each source to
+ */
+void compileImports(const ObjectModule& module, const fs::path& directory,
+                    const CompileOptions& options, std::set<fs::path>& seen,
+                    std::vector<ObjectModule>& modules,
+                    std::vector<std::string>* imported) {
+    for (const auto& path : module.imports) {
+        fs::path sourcePath = directory / path;
+        std::error_code err;
+        fs::path canonical = fs::weakly_canonical(sourcePath, err);
+        if (!seen.insert(err ? sourcePath : canonical).second) {
+            continue;
+        }
+        if (imported != nullptr) {
+            imported->push_back(sourcePath.string());
+        }
+
+        auto source = openSource(sourcePath.string(), options);
+        AstArena arena;
+        AstProgram* program = buildProgram(*source, arena, options, true);
+        ObjectModule dependency =
+            translateModule(program, sourcePath.string(), options);
+        compileImports(dependency, sourcePath.parent_path(), options, seen,
+                       modules, imported);
+        modules.push_back(std::move(dependency));
+    }
+}
+
+/**
+ * Compiles the modules a program imports, and links the program with them.
+ *
+ * @param inFilename the path of the program's source, or "-" for stdin
+ * @param imported if not null, the list to add the path of each imported
+ * source to
+ */
+void linkProgram(AstProgram* program, const std::string& inFilename,
+                 std::ostream& out, const CompileOptions& options,
+                 std::vector<std::string>* imported) {
+    // imports are relative to the importing source
+    fs::path directory;
+    std::set<fs::path> seen;
+    if (inFilename != "-") {
+        directory = fs::path(inFilename).parent_path();
+        std::error_code err;
+        seen.insert(fs::weakly_canonical(inFilename, err));
+    }
+
+    // imports always name punch code, even from an encoded program
+    CompileOptions importOptions = options;
+    importOptions.astInput = false;
+
+    ObjectModule module = translateModule(program, inFilename, options);
+    std::vector<ObjectModule> modules;
+    compileImports(module, directory, importOptions, seen, modules,
+                   imported);
+    modules.push_back(std::move(module));
+
+    CompileStats::Timer timer(options.stats, "link");
+    Linker::link(modules, out);
+}
+
+} // namespace
+
+std::string compileScript(const std::string& inFilename,
+                          const CompileOptions& options,
+                          std::vector<std::string>* imported) {
+    // map in the source code
+    auto source = openSource(inFilename, options);
+
+    // serve the script from the cache if this source was compiled before
+    std::string cacheKey;
+    if (options.cache != nullptr) {
+        CompileStats::Timer timer(options.stats, "cache");
+        cacheKey = getCacheKey(source->getText(), options);
+        if (auto script = options.cache->load(cacheKey)) {
+            return std::move(*script);
+        }
+    }
+
+    AstArena arena;
+    AstProgram* program = buildProgram(*source, arena, options);
+    std::stringstream script;
+    if (program->getImports().empty()) {
+        translateProgram(program, script, options);
+    } else {
+        linkProgram(program, inFilename, script, options, imported);
+    }
+
+    // the key only covers this source, so a script that also depends on
+    // imported sources is never stored
+    if (options.cache != nullptr && program->getImports().empty()) {
+        CompileStats::Timer timer(options.stats, "cache");
+        options.cache->store(cacheKey, script.str());
+    }
+    return script.str();
+}
+
+void compileFile(const std::string& inFilename,
+                 const std::string& outFilename,
+                 const CompileOptions& options) {
+    // a cached script is copied out whole
+    if (options.cache != nullptr) {
+        std::string script = compileScript(inFilename, options);
+        std::ofstream outFile;
+        openOutput(outFilename, outFile) << script << std::flush;
+        return;
+    }
+
+    // map in the source code
+    auto source = openSource(inFilename, options);
+
+    AstArena arena;
+    AstProgram* program = buildProgram(*source, arena, options);
+
+    // imported modules may fail to compile too, so link before writing
+    std::stringstream linked;
+    bool imports = !program->getImports().empty();
+    if (imports) {
+        linkProgram(program, inFilename, linked, options, nullptr);
+    }
+
+    // decide where to write the result; the output file is only opened once
+    // the program has parsed, so a failed compile leaves it untouched
+    std::ofstream outFile;
+    std::ostream& out = openOutput(outFilename, outFile);
+
+    if (imports) {
+        out << linked.str() << std::flush;
+    } else {
+        // translate straight into the output
+        translateProgram(program, out, options);
+    }
+}
+
+void compileObject(const std::string& inFilename,
+                   const std::string& outFilename,
+                   const CompileOptions& options) {
+    auto source = openSource(inFilename, options);
+    AstArena arena;
+    AstProgram* program = buildProgram(*source, arena, options, true);
+    ObjectModule module = translateModule(program, inFilename, options);
+
+    std::ofstream outFile;
+    std::ostream& out = openOutput(outFilename, outFile);
+    module.write(out);
+    out.flush();
+}
+
+void emitAst(const std::string& inFilename, const std::string& outFilename) {
+    auto source = SourceBuffer::open(inFilename);
+    AstArena arena;
+    AstProgram* program = readProgram(*source, arena, CompileOptions());
+
+    std::ofstream outFile;
+    std::ostream& out = openOutput(outFilename, outFile);
+    AstBinary::write(program, out);
+    out.flush();
+}
+
+void linkObjects(const std::vector<std::string>& inFilenames,
+                 const std::string& outFilename) {
+    std::vector<ObjectModule> modules;
+    for (const auto& inFilename : inFilenames) {
+        auto object = SourceBuffer::open(inFilename);
+        modules.push_back(ObjectModule::read(object->getText(), inFilename));
+    }
+
+    std::stringstream script;
+    Linker::link(modules, script);
+
+    std::ofstream outFile;
+    openOutput(outFilename, outFile) << script.str() << std::flush;
+}
+
+size_t compileBatch(const std::vector<std::string>& inFilenames,
+                    const std::string& outDirectory, size_t jobCount,
+                    const CompileOptions& options) {
+    std::error_code err;
+    fs::create_directories(outDirectory, err);
+    if (err) {
+        throw IOException("cannot create '" + outDirectory +
+                          "': " + err.message());
+    }
+
+    // work out every output path up front, so clashes are caught before
+    // anything is written
+    std::vector<std::string> outFilenames;
+    std::map<std::string, std::string> claimed;
+    for (const auto& inFilename : inFilenames) {
+        fs::path outPath = fs::path(outDirectory) /
+                           fs::path(inFilename).stem().concat(".sh");
+        auto [pos, inserted] = claimed.emplace(outPath.string(), inFilename);
+        if (!inserted) {
+            throw IOException("'" + inFilename + "' and '" + pos->second +
+                              "' would both compile to '" +
+                              outPath.string() + "'");
+        }
+        outFilenames.push_back(outPath.string());
+    }
+
+    std::mutex reportMutex;
+    size_t failures = 0;
+
+    ThreadPool pool(jobCount);
+    for (size_t i = 0; i < inFilenames.size(); i++) {
+        pool.submit([&, i]() {
+            try {
+                compileFile(inFilenames[i], outFilenames[i], options);
+            } catch (const PunchException& e) {
+                std::lock_guard<std::mutex> lock(reportMutex);
+                std::cout << inFilenames[i] << ": "
+                          << PunchException::describe(e) << std::endl;
+                failures++;
+            } catch (const std::exception& e) {
+                // anything else, such as running out of memory, only fails
+                // this source rather than escaping the pool's worker
+                std::lock_guard<std::mutex> lock(reportMutex);
+                std::cout << inFilenames[i] << ": Internal error: "
+                          << e.what() << std::endl;
+                failures++;
+            }
+        });
+    }
+    pool.wait();
+
+    return failures;
+}
+
+std::vector<std::string> readManifest(const std::string& filename) {
+    auto manifest = SourceBuffer::open(filename);
+    std::string_view text = manifest->getText();
+
+    std::vector<std::string> result;
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? "" : text.substr(end + 1);
+
+        // trim surrounding whitespace
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos) {
+            continue;
+        }
+        line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+
+        if (line[0] != '#') {
+            result.emplace_back(line);
+        }
+    }
+    return result;
+}
+
+} // namespace Driver
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class CompileCache;
+class CompileStats;
+
+/**
+ * Entry points tying the compiler stages together.
+ */
+namespace Driver {
+
+// the compiler version, part of every cache key; bump it whenever the
+// generated code changes
+constexpr std::string_view VERSION = "0.1.0";
+
+/**
+ * Settings controlling how programs are compiled.
+ */
+struct CompileOptions {
+    // evaluate constant arithmetic at compile time
+    bool foldConstants = true;
+
+    // replace calls to small functions by their bodies
+    bool inlineFunctions = true;
+
+    // drop unreachable statements and functions
+    bool eliminateDeadCode = true;
+
+    // evaluate loop-invariant arithmetic once, ahead of its loop
+    bool hoistInvariants = true;
+
+    // cache the results of every pure function worth caching, not only
+    // those annotated with @memo
+    bool memoizeAll = false;
+
+    // most results each memoization cache holds before it is emptied, or 0
+    // for no limit
+    size_t memoLimit = 0;
+
+    // read sources as ASTs encoded by emitAst, rather than as punch code
+    bool astInput = false;
+
+    // map sources into memory rather than reading them in; a long-running
+    // process reads them, as a mapped file truncated under it raises SIGBUS
+    bool mapSources = true;
+
+    // serve and store scripts through this cache, unless it is null
+    CompileCache* cache = nullptr;
+
+    // record how long each stage takes into these statistics, unless they
+    // are null; they play no part in the script
+    CompileStats* stats = nullptr;
+};
+
+/**
+ * Compiles a single punch source into a bash script.
+ *
+ * Every call uses its own scanner, parser, arena and translator, so separate
+ * calls may safely run concurrently.
+ *
+ * A source that imports other modules is compiled together with them, each
+ * import resolved relative to the importing source, and the modules are
+ * linked into one script.
+ *
+ * With a cache, a source compiled before with the same compiler version and
+ * options is not compiled again; its script is copied out of the cache.
+ *
+ * @param inFilename the path of the source, or "-" for stdin
+ * @param outFilename the path to write the script to, or empty for stdout
+ * @param options the compilation settings
+ *
+ * @throws PunchException if the source cannot be read or compiled
+ */
+void compileFile(const std::string& inFilename,
+                 const std::string& outFilename,
+                 const CompileOptions& options = CompileOptions());
+
+/**
+ * Compiles a single punch source into a bash script held in memory.
+ *
+ * Like compileFile, this may run concurrently with other compilations, and
+ * goes through the cache if the options give one.
+ *
+ * @param inFilename the path of the source, or "-" for stdin
+ * @param options the compilation settings
+ * @param imported if not null, receives the paths of the sources the script
+ * was linked from, besides the source itself
+ * @return the script
+ *
+ * @throws PunchException if the source cannot be read or compiled
+ */
+std::string compileScript(const std::string& inFilename,
+                          const CompileOptions& options = CompileOptions(),
+                          std::vector<std::string>* imported = nullptr);
+
+/**
+ * Compiles a single punch source as a module, into an object file to be
+ * linked with other modules later.
+ *
+ * Its imports are recorded, but not compiled; each imported module is
+ * compiled into an object of its own.
+ *
+ * @param inFilename the path of the source, or "-" for stdin
+ * @param outFilename the path to write the object to, or empty for stdout
+ * @param options the compilation settings; any cache is not used
+ *
+ * @throws PunchException if the source cannot be read or compiled
+ */
+void compileObject(const std::string& inFilename,
+                   const std::string& outFilename,
+                   const CompileOptions& options = CompileOptions());
+
+/**
+ * Parses a single punch source, writing out its AST in the binary encoding
+ * of AstBinary, so later compilations with astInput set can skip scanning
+ * and parsing.
+ *
+ * The AST is written as parsed; the simplifying passes still run on every
+ * compilation from it. Imports stay relative to the source's directory.
+ *
+ * @param inFilename the path of the source, or "-" for stdin
+ * @param outFilename the path to write the AST to, or empty for stdout
+ *
+ * @throws PunchException if the source cannot be read or parsed
+ */
+void emitAst(const std::string& inFilename, const std::string& outFilename);
+
+/**
+ * Links object files into a bash script, keeping only the functions the
+ * program can reach.
+ *
+ * @param inFilenames the paths of the objects, each after the objects of
+ * the modules it imports
+ * @param outFilename the path to write the script to, or empty for stdout
+ *
+ * @throws PunchException if an object cannot be read, or the objects do
+ * not link
+ */
+void linkObjects(const std::vector<std::string>& inFilenames,
+                 const std::string& outFilename);
+
+/**
+ * Compiles many punch sources concurrently, writing each script into an
+ * output directory as <name>.sh.
+ *
+ * Failures are reported on stdout as they happen and do not stop the rest of
+ * the batch.
+ *
+ * @param inFilenames the paths of the sources
+ * @param outDirectory the directory to write the scripts to
+ * @param jobCount the number of worker threads; 0 means one per core
+ * @param options the compilation settings
+ * @return the number of sources that failed to compile
+ */
+size_t compileBatch(const std::vector<std::string>& inFilenames,
+                    const std::string& outDirectory, size_t jobCount,
+                    const CompileOptions& options = CompileOptions());
+
+/**
+ * Reads a batch manifest, listing one source path per line.
+ *
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * @param filename the path of the manifest, or "-" for stdin
+ * @return the listed source paths
+ *
+ * @throws IOException if the manifest cannot be read
+ */
+std::vector<std::string> readManifest(const std::string& filename);
+
+} // namespace Driver
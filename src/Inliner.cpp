@@ -0,0 +1,146 @@
+#include "Inliner.h"
+#include "AstUtils.h"
+
+namespace {
+
+size_t getSize(const AstExpression* expr) {
+    if (const auto* binary = dyn_cast<AstBinaryExpression>(expr)) {
+        return 1 + getSize(binary->getLHS()) + getSize(binary->getRHS());
+    }
+    return 1;
+}
+
+size_t countUses(const AstExpression* expr, std::string_view name) {
+    if (const auto* binary = dyn_cast<AstBinaryExpression>(expr)) {
+        return countUses(binary->getLHS(), name) +
+               countUses(binary->getRHS(), name);
+    }
+    const auto* var = dyn_cast<AstVariable>(expr);
+    return var != nullptr && var->getName() == name ? 1 : 0;
+}
+
+} // namespace
+
+void Inliner::run(AstProgram* program) {
+    statementCalls = AstUtils::findStatementCalls(program);
+
+    // inlining a helper can make its caller small enough to inline in turn,
+    // so repeat until nothing changes
+    inlinedCount = 0;
+    size_t previousCount;
+    do {
+        previousCount = inlinedCount;
+        findCandidates(program);
+        program->apply(*this);
+    } while (inlinedCount != previousCount);
+}
+
+AstNode* Inliner::mapNode(AstNode* node) const {
+    node->apply(*this);
+
+    const auto* call = dyn_cast<AstFunctionCall>(node);
+    if (call == nullptr || statementCalls.count(call) != 0) {
+        return node;
+    }
+
+    if (AstExpression* expr = inlineCall(call)) {
+        inlinedCount++;
+        return expr;
+    }
+    return node;
+}
+
+void Inliner::findCandidates(const AstProgram* program) {
+    candidates.clear();
+
+    std::unordered_set<std::string_view> redefined;
+    for (const auto* function : program->getFunctions()) {
+        if (!candidates.emplace(function->getName(), function).second) {
+            redefined.insert(function->getName());
+        }
+    }
+
+    for (auto it = candidates.begin(); it != candidates.end();) {
+        const AstFunctionDecl* function = it->second;
+        const auto& stmts = function->getStatements();
+        const auto* ret =
+            stmts.size() == 1 ? dyn_cast<AstReturn>(stmts[0]) : nullptr;
+
+        bool eligible = redefined.count(function->getName()) == 0 &&
+                        ret != nullptr &&
+                        AstUtils::isSideEffectFree(ret->getExpression()) &&
+                        getSize(ret->getExpression()) <= MAX_INLINE_SIZE;
+
+        // a repeated parameter name leaves it unclear which argument is used
+        std::unordered_set<std::string_view> params;
+        for (const auto* param : function->getArguments()) {
+            eligible = eligible && params.insert(param->getName()).second;
+        }
+
+        it = eligible ? std::next(it) : candidates.erase(it);
+    }
+}
+
+AstExpression* Inliner::inlineCall(const AstFunctionCall* call) const {
+    auto pos = candidates.find(call->getName());
+    if (pos == candidates.end()) {
+        return nullptr;
+    }
+
+    const AstFunctionDecl* function = pos->second;
+    const auto& params = function->getArguments();
+    const auto& args = call->getArguments();
+    if (params.size() != args.size()) {
+        return nullptr;
+    }
+
+    const AstExpression* body =
+        cast<AstReturn>(function->getStatements()[0])->getExpression();
+
+    std::unordered_map<std::string_view, const AstExpression*> arguments;
+    for (size_t i = 0; i < params.size(); i++) {
+        std::string_view name = params[i]->getName();
+
+        // arguments are only evaluated once at a real call site, so only
+        // duplicate those that are cheap and have no side effects
+        if (!AstUtils::isSideEffectFree(args[i])) {
+            return nullptr;
+        }
+        if (isa<AstBinaryExpression>(args[i]) && countUses(body, name) > 1) {
+            return nullptr;
+        }
+        arguments[name] = args[i];
+    }
+
+    return substitute(body, arguments);
+}
+
+AstExpression* Inliner::substitute(
+    const AstExpression* expr,
+    const std::unordered_map<std::string_view, const AstExpression*>&
+        arguments) const {
+    switch (expr->getKind()) {
+    case AstKind::Variable: {
+        std::string_view name = cast<AstVariable>(expr)->getName();
+        auto pos = arguments.find(name);
+        if (pos != arguments.end()) {
+            return substitute(pos->second, {});
+        }
+        return arena.create<AstVariable>(name);
+    }
+    case AstKind::NumberLiteral:
+        return arena.create<AstNumberLiteral>(
+            cast<AstNumberLiteral>(expr)->getNumber());
+    case AstKind::StringLiteral:
+        return arena.create<AstStringLiteral>(
+            cast<AstStringLiteral>(expr)->getString());
+    case AstKind::BinaryExpression: {
+        const auto* binary = cast<AstBinaryExpression>(expr);
+        return arena.create<AstBinaryExpression>(
+            binary->getOperator(), substitute(binary->getLHS(), arguments),
+            substitute(binary->getRHS(), arguments));
+    }
+    default: assert(false && "unexpected expression in inlined body");
+    }
+    return nullptr;
+}
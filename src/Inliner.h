@@ -0,0 +1,85 @@
+#pragma once
+
+#include "AstArena.h"
+#include "AstNode.h"
+#include "AstProgram.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * AST pass inlining small functions at their call sites.
+ *
+ * A function is inlined if its body is a single return of a small
+ * expression over variables and literals, so that the call can be replaced
+ * by that expression with the arguments substituted for the parameters. A
+ * function that still calls anything, itself included, is never inlined;
+ * calls to inlined helpers are expanded first, so chains of helpers collapse
+ * completely.
+ *
+ * Arguments are substituted as expression trees rather than by name, so no
+ * new variables are introduced and nothing at the call site can be captured.
+ * Names left in the body refer to globals, which bash resolves through the
+ * caller's scope whether or not the call is inlined.
+ *
+ * The function definitions themselves are kept, since raw code may still
+ * call them by name.
+ */
+class Inliner : public AstNodeMapper {
+public:
+    /**
+     * Maximum number of nodes in an inlined function body.
+     */
+    static constexpr size_t MAX_INLINE_SIZE = 16;
+
+    /**
+     * @param arena the arena the program was allocated in, to hold the
+     * inlined copies
+     */
+    Inliner(AstArena& arena) : arena(arena), inlinedCount(0) {}
+
+    /**
+     * Inlines every eligible call in the program, in place.
+     */
+    void run(AstProgram* program);
+
+    AstNode* mapNode(AstNode* node) const override;
+
+    /**
+     * Gets the number of call sites inlined by the last run.
+     */
+    size_t getInlinedCount() const { return inlinedCount; }
+
+private:
+    AstArena& arena;
+
+    // functions that can currently be inlined
+    std::unordered_map<std::string_view, const AstFunctionDecl*> candidates;
+
+    // calls whose result is discarded, which are left alone
+    std::unordered_set<const AstNode*> statementCalls;
+
+    mutable size_t inlinedCount;
+
+    /**
+     * Collects the functions that can be inlined in the current program.
+     */
+    void findCandidates(const AstProgram* program);
+
+    /**
+     * Builds the expression replacing a call.
+     *
+     * @return the inlined expression, or nullptr if the call cannot be
+     * inlined
+     */
+    AstExpression* inlineCall(const AstFunctionCall* call) const;
+
+    /**
+     * Copies an expression, replacing parameters by their arguments.
+     */
+    AstExpression* substitute(
+        const AstExpression* expr,
+        const std::unordered_map<std::string_view, const AstExpression*>&
+            arguments) const;
+};
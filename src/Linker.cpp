@@ -0,0 +1,84 @@
+#include "Linker.h"
+#include "CodeEmitter.h"
+#include "PunchException.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Linker {
+
+void link(const std::vector<ObjectModule>& modules, std::ostream& out) {
+    // a module may define a function more than once, in which case bash
+    // keeps the last definition, but two modules may not share a name
+    std::unordered_map<std::string_view, const ObjectModule*> owners;
+    std::unordered_map<std::string_view,
+                       std::vector<const ObjectModule::Function*>>
+        symbols;
+    for (const auto& module : modules) {
+        for (const auto& function : module.functions) {
+            auto [pos, added] = owners.emplace(function.name, &module);
+            if (!added && pos->second != &module) {
+                throw LinkException("function '" + function.name +
+                                    "' is defined in both '" +
+                                    pos->second->name + "' and '" +
+                                    module.name + "'");
+            }
+            symbols[function.name].push_back(&function);
+        }
+    }
+
+    auto entry = symbols.find("main");
+    if (entry == symbols.end()) {
+        throw LinkException("no module defines 'main'");
+    }
+
+    // everything the program runs at startup is a root
+    std::vector<std::string_view> worklist = {"main"};
+    for (const auto& module : modules) {
+        for (const auto& reference : module.globalReferences) {
+            worklist.push_back(reference);
+        }
+    }
+
+    std::unordered_set<std::string_view> reachable;
+    while (!worklist.empty()) {
+        std::string_view name = worklist.back();
+        worklist.pop_back();
+
+        // references to anything but a function are left to bash
+        auto pos = symbols.find(name);
+        if (pos == symbols.end() || !reachable.insert(name).second) {
+            continue;
+        }
+        for (const auto* function : pos->second) {
+            for (const auto& reference : function->references) {
+                worklist.push_back(reference);
+            }
+        }
+    }
+
+    CodeEmitter emitter(out);
+    emitter << "#!/bin/bash\n\n";
+
+    for (const auto& module : modules) {
+        if (!module.globals.empty()) {
+            emitter << "# set up " << module.name << "\n";
+            emitter << module.globals << "\n";
+        }
+    }
+
+    emitter << "# functions\n";
+    for (const auto& module : modules) {
+        for (const auto& function : module.functions) {
+            if (reachable.count(function.name) != 0) {
+                emitter << function.code << "\n\n";
+            }
+        }
+    }
+
+    emitter << "# start the program\n";
+    emitter << entry->second.back()->bashName << "\n";
+}
+
+} // namespace Linker
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ObjectModule.h"
+
+#include <iostream>
+#include <vector>
+
+/**
+ * Final step of separate compilation, combining compiled modules into a
+ * single script.
+ */
+namespace Linker {
+
+/**
+ * Links modules into a script that runs main.
+ *
+ * Only the functions reachable from main, or from the global setup of some
+ * module, are included. The global setup of each module runs in the order
+ * the modules are given, so a module should come after the modules it
+ * imports.
+ *
+ * @param modules the modules to link
+ * @param out the stream to write the script to
+ *
+ * @throws LinkException if two modules define the same function, or no
+ * module defines main
+ */
+void link(const std::vector<ObjectModule>& modules, std::ostream& out);
+
+} // namespace Linker
@@ -0,0 +1,169 @@
+#include "LoopInvariantHoister.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using NameSet = std::unordered_set<std::string_view>;
+
+/**
+ * Collects the variables assigned within a loop, noting whether the loop
+ * also contains code that may assign variables the pass cannot see.
+ */
+class AssignmentCollector : public AstNodeMapper {
+public:
+    AssignmentCollector(NameSet& assigned, bool& opaque)
+        : assigned(assigned), opaque(opaque) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* assignment = dyn_cast<AstAssignment>(node)) {
+            assigned.insert(assignment->getVariable()->getName());
+        } else if (isa<AstFunctionCall>(node) || isa<AstRawEnvironment>(node)) {
+            opaque = true;
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    NameSet& assigned;
+    bool& opaque;
+};
+
+bool isInvariant(const AstExpression* expr, const NameSet& assigned) {
+    switch (expr->getKind()) {
+    case AstKind::NumberLiteral: return true;
+    case AstKind::Variable:
+        return assigned.count(cast<AstVariable>(expr)->getName()) == 0;
+    case AstKind::BinaryExpression: {
+        const auto* binary = cast<AstBinaryExpression>(expr);
+        BinaryOperator op = binary->getOperator();
+        return op != BinaryOperator::DIV && op != BinaryOperator::MOD &&
+               isInvariant(binary->getLHS(), assigned) &&
+               isInvariant(binary->getRHS(), assigned);
+    }
+    default: return false;
+    }
+}
+
+/**
+ * Replaces each maximal invariant expression by a variable, recording the
+ * expression to assign to it. Repeated copies of an expression share one
+ * variable.
+ */
+class InvariantReplacer : public AstNodeMapper {
+public:
+    InvariantReplacer(
+        AstArena& arena, const NameSet& assigned, size_t& count,
+        std::vector<std::pair<std::string_view, AstExpression*>>& hoisted)
+        : arena(arena), assigned(assigned), count(count), hoisted(hoisted) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        auto* expr = dyn_cast<AstBinaryExpression>(node);
+        if (expr != nullptr && isInvariant(expr, assigned)) {
+            // the printed form of an expression identifies it structurally
+            std::stringstream key;
+            key << *expr;
+            auto [pos, added] = variables.emplace(key.str(), "");
+            if (added) {
+                // punch identifiers cannot contain '_', so this cannot clash
+                std::string name = "_invariant_" + std::to_string(count++);
+                pos->second = arena.copyString(name);
+                hoisted.emplace_back(pos->second, expr);
+            }
+            return arena.create<AstVariable>(pos->second);
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    AstArena& arena;
+    const NameSet& assigned;
+    size_t& count;
+    std::vector<std::pair<std::string_view, AstExpression*>>& hoisted;
+    mutable std::unordered_map<std::string, std::string_view> variables;
+};
+
+} // namespace
+
+AstNode* LoopInvariantHoister::mapNode(AstNode* node) const {
+    if (auto* loop = dyn_cast<AstLoop>(node)) {
+        // hoist out of the outer loop first, then out of any nested loops
+        AstStatement* result = hoistInvariants(loop);
+        loop->apply(*this);
+        return result;
+    }
+    node->apply(*this);
+
+    if (auto* function = dyn_cast<AstFunctionDecl>(node)) {
+        spliceBlocks(function->getStatements());
+    } else if (auto* block = dyn_cast<AstStatementBlock>(node)) {
+        spliceBlocks(block->getStatements());
+    }
+    return node;
+}
+
+void LoopInvariantHoister::spliceBlocks(AstList<AstStatement*>& stmts) const {
+    std::vector<AstStatement*> result;
+    bool spliced = false;
+    for (auto* stmt : stmts) {
+        // blocks introduce no scope in bash, so a loop's declarations can
+        // precede it directly in the enclosing list
+        if (blocks.count(stmt) != 0) {
+            const auto* block = cast<AstStatementBlock>(stmt);
+            for (auto* inner : block->getStatements()) {
+                result.push_back(inner);
+            }
+            spliced = true;
+        } else {
+            result.push_back(stmt);
+        }
+    }
+    if (!spliced) {
+        return;
+    }
+
+    stmts.clear();
+    for (auto* stmt : result) {
+        stmts.push_back(stmt);
+    }
+}
+
+AstStatement* LoopInvariantHoister::hoistInvariants(AstLoop* loop) const {
+    NameSet assigned;
+    bool opaque = false;
+    AssignmentCollector collector(assigned, opaque);
+    collector.mapNode(loop);
+    if (opaque) {
+        return loop;
+    }
+
+    // the initializer of a for loop only runs once anyway
+    std::vector<std::pair<std::string_view, AstExpression*>> hoisted;
+    InvariantReplacer replacer(arena, assigned, hoistedCount, hoisted);
+    loop->getCondition()->apply(replacer);
+    if (auto* forLoop = dyn_cast<AstForLoop>(loop)) {
+        forLoop->getStep()->apply(replacer);
+    }
+    loop->getBody()->apply(replacer);
+
+    if (hoisted.empty()) {
+        return loop;
+    }
+
+    auto* block = arena.create<AstStatementBlock>(arena);
+    for (const auto& [name, expr] : hoisted) {
+        auto* var = arena.create<AstVariable>(name);
+        block->appendStatement(arena.create<AstAssignment>(true, var, expr));
+    }
+    block->appendStatement(loop);
+    blocks.insert(block);
+    return block;
+}
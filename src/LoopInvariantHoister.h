@@ -0,0 +1,67 @@
+#pragma once
+
+#include "AstArena.h"
+#include "AstNode.h"
+#include "AstProgram.h"
+
+#include <unordered_set>
+
+/**
+ * AST pass moving arithmetic that yields the same value on every iteration
+ * of a loop out in front of the loop.
+ *
+ * An arithmetic expression is invariant in a loop if none of the variables
+ * it reads is assigned anywhere in the loop. Each maximal invariant
+ * expression is evaluated once into a new variable declared just before the
+ * loop, and the loop reads that variable instead. Outer loops are handled
+ * first, so an expression lands in front of the outermost loop it is
+ * invariant in.
+ *
+ * Loops containing calls or raw code are left alone, since either may assign
+ * any variable. Expressions that divide are never hoisted: the loop might not
+ * have evaluated them at all, and hoisting could introduce a division by
+ * zero that the original program never performed.
+ */
+class LoopInvariantHoister : public AstNodeMapper {
+public:
+    /**
+     * @param arena the arena the program was allocated in, to hold the new
+     * declarations
+     */
+    LoopInvariantHoister(AstArena& arena) : arena(arena), hoistedCount(0) {}
+
+    /**
+     * Hoists the invariant expressions out of every loop in the program, in
+     * place.
+     */
+    void run(AstProgram* program) { program->apply(*this); }
+
+    AstNode* mapNode(AstNode* node) const override;
+
+    /**
+     * Gets the number of expressions hoisted so far.
+     */
+    size_t getHoistedCount() const { return hoistedCount; }
+
+private:
+    AstArena& arena;
+
+    // also numbers the variables holding the hoisted values
+    mutable size_t hoistedCount;
+
+    // the blocks made to hold a loop and its declarations
+    mutable std::unordered_set<const AstStatement*> blocks;
+
+    /**
+     * Hoists the expressions invariant in a single loop.
+     *
+     * @return the loop, preceded by the declarations of any hoisted values
+     */
+    AstStatement* hoistInvariants(AstLoop* loop) const;
+
+    /**
+     * Replaces the blocks made for hoisting in a list of statements by the
+     * statements inside them.
+     */
+    void spliceBlocks(AstList<AstStatement*>& stmts) const;
+};
@@ -0,0 +1,45 @@
+#include "Memoizer.h"
+#include "AstFunction.h"
+#include "PunchException.h"
+#include "PurityAnalysis.h"
+
+#include <string>
+
+namespace {
+
+/**
+ * Checks whether code makes calls or loops, and so may be slow to rerun.
+ */
+class WorkFinder : public AstNodeMapper {
+public:
+    WorkFinder(bool& found) : found(found) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        found = found || isa<AstFunctionCall>(node) || isa<AstLoop>(node);
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    bool& found;
+};
+
+} // namespace
+
+void Memoizer::run(AstProgram* program) {
+    PurityAnalysis purity(program);
+
+    for (auto* function : program->getFunctions()) {
+        bool pure = purity.isPure(function->getName());
+        if (function->isMemoized() && !pure) {
+            throw SemanticException("cannot memoize impure function '" +
+                                    std::string(function->getName()) + "'");
+        }
+
+        if (memoizeAll && pure && !function->getArguments().empty()) {
+            bool work = false;
+            function->apply(WorkFinder(work));
+            function->setMemoized(function->isMemoized() || work);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "AstNode.h"
+#include "AstProgram.h"
+
+/**
+ * Pass choosing the functions whose results the translator caches.
+ *
+ * Caching is only sound for pure functions, as found by PurityAnalysis, so
+ * a function annotated with @memo must be pure. When memoizing everything,
+ * each pure function taking arguments is memoized as well, provided it does
+ * enough work to outweigh the cache lookup, i.e. it makes calls or loops.
+ */
+class Memoizer {
+public:
+    /**
+     * @param memoizeAll whether to memoize unannotated pure functions too
+     */
+    Memoizer(bool memoizeAll) : memoizeAll(memoizeAll) {}
+
+    /**
+     * Marks the functions to memoize, in place.
+     *
+     * @throws SemanticException if an annotated function is not pure
+     */
+    void run(AstProgram* program);
+
+private:
+    bool memoizeAll;
+};
@@ -0,0 +1,183 @@
+#include "ObjectModule.h"
+#include "Driver.h"
+#include "PunchException.h"
+
+#include <charconv>
+
+/*
+ * An object file is a header line naming the compiler version, followed by a
+ * sequence of records. Each record is a line of space-separated words ending
+ * in a byte count, followed by that many bytes of text and a newline:
+ *
+ *     punch-object VERSION
+ *     import LENGTH
+ *     PATH
+ *     globals REFCOUNT REF... LENGTH
+ *     CODE
+ *     function NAME BASHNAME REFCOUNT REF... LENGTH
+ *     CODE
+ *
+ * Names and references are identifiers, which never contain spaces, while
+ * paths and code are free text.
+ */
+
+namespace {
+
+const std::string_view MAGIC = "punch-object";
+
+/**
+ * Writes a record.
+ *
+ * @param header the words of the header line before the byte count, each
+ * followed by a space
+ */
+void writeRecord(std::ostream& os, const std::string& header,
+                 std::string_view text) {
+    os << header << text.size() << "\n" << text << "\n";
+}
+
+/**
+ * Formats a reference list for a record header.
+ */
+std::string formatReferences(const std::vector<std::string>& references) {
+    std::string result = std::to_string(references.size()) + " ";
+    for (const auto& reference : references) {
+        result += reference + " ";
+    }
+    return result;
+}
+
+/**
+ * Reads the records of an object file in order.
+ */
+class RecordReader {
+public:
+    RecordReader(std::string_view text, const std::string& name)
+        : text(text), name(name) {}
+
+    bool hasNext() const { return !text.empty(); }
+
+    /**
+     * Reads the header line of the next record.
+     *
+     * @return the words of the line
+     */
+    std::vector<std::string_view> readHeader() {
+        size_t end = text.find('\n');
+        if (end == std::string_view::npos) {
+            generateError();
+        }
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end + 1);
+
+        std::vector<std::string_view> words;
+        while (!line.empty()) {
+            size_t space = line.find(' ');
+            words.push_back(line.substr(0, space));
+            line = space == std::string_view::npos ? ""
+                                                   : line.substr(space + 1);
+        }
+        return words;
+    }
+
+    /**
+     * Reads the text of a record whose header has been read.
+     */
+    std::string_view readText(std::string_view length) {
+        size_t size = readCount(length);
+        if (size >= text.size() || text[size] != '\n') {
+            generateError();
+        }
+        std::string_view result = text.substr(0, size);
+        text.remove_prefix(size + 1);
+        return result;
+    }
+
+    size_t readCount(std::string_view digits) {
+        const char* end = digits.data() + digits.size();
+        size_t count = 0;
+        auto result = std::from_chars(digits.data(), end, count);
+        if (result.ec != std::errc() || result.ptr != end) {
+            generateError();
+        }
+        return count;
+    }
+
+    [[noreturn]] void generateError() {
+        throw IOException("'" + name + "' is not a valid punch object");
+    }
+
+private:
+    std::string_view text;
+    const std::string& name;
+};
+
+/**
+ * Splits the reference list out of the header of a globals or function
+ * record.
+ *
+ * @param words the header, from the reference count onwards
+ * @return the references
+ */
+std::vector<std::string> readReferences(RecordReader& reader,
+                                        std::vector<std::string_view> words) {
+    size_t count = reader.readCount(words[0]);
+    if (words.size() != count + 2) {
+        reader.generateError();
+    }
+    return std::vector<std::string>(words.begin() + 1, words.end() - 1);
+}
+
+} // namespace
+
+void ObjectModule::write(std::ostream& os) const {
+    os << MAGIC << " " << Driver::VERSION << "\n";
+    for (const auto& path : imports) {
+        writeRecord(os, "import ", path);
+    }
+    writeRecord(os, "globals " + formatReferences(globalReferences), globals);
+    for (const auto& function : functions) {
+        writeRecord(os,
+                    "function " + function.name + " " + function.bashName +
+                        " " + formatReferences(function.references),
+                    function.code);
+    }
+}
+
+ObjectModule ObjectModule::read(std::string_view text,
+                                const std::string& name) {
+    RecordReader reader(text, name);
+    std::vector<std::string_view> header = reader.readHeader();
+    if (header.size() != 2 || header[0] != MAGIC) {
+        reader.generateError();
+    }
+    if (header[1] != Driver::VERSION) {
+        throw IOException("'" + name + "' was compiled by punch " +
+                          std::string(header[1]) + ", not " +
+                          std::string(Driver::VERSION));
+    }
+
+    ObjectModule module;
+    module.name = name;
+    while (reader.hasNext()) {
+        std::vector<std::string_view> words = reader.readHeader();
+        if (words.size() == 2 && words[0] == "import") {
+            module.imports.emplace_back(reader.readText(words[1]));
+        } else if (words.size() >= 3 && words[0] == "globals") {
+            module.globalReferences =
+                readReferences(reader, {words.begin() + 1, words.end()});
+            module.globals = reader.readText(words.back());
+        } else if (words.size() >= 5 && words[0] == "function") {
+            Function function;
+            function.name = words[1];
+            function.bashName = words[2];
+            function.references =
+                readReferences(reader, {words.begin() + 3, words.end()});
+            function.code = reader.readText(words.back());
+            module.functions.push_back(std::move(function));
+        } else {
+            reader.generateError();
+        }
+    }
+    return module;
+}
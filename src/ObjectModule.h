@@ -0,0 +1,60 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A punch module compiled on its own, ready to be linked with others.
+ *
+ * Holds the translated bash code of the module, split into the setup it runs
+ * at startup and its separate function definitions, along with the symbol
+ * table the linker works from: the punch name of each function, the bash
+ * name it is defined under, and the names its code refers to.
+ *
+ * References are recorded without knowing what they name. A reference may be
+ * a function of another module, a bash command, or merely a word of raw code;
+ * the linker only follows those that some module defines.
+ */
+struct ObjectModule {
+    /**
+     * A function definition, with its entry in the symbol table.
+     */
+    struct Function {
+        std::string name;
+        std::string bashName;
+        std::vector<std::string> references;
+        std::string code;
+    };
+
+    // the path of the source, for diagnostics
+    std::string name;
+
+    // the paths of the modules the source imports, as written
+    std::vector<std::string> imports;
+
+    // the memoization caches and global variables, set up at startup
+    std::string globals;
+    std::vector<std::string> globalReferences;
+
+    // the function definitions, in source order
+    std::vector<Function> functions;
+
+    /**
+     * Writes the module in object file form.
+     */
+    void write(std::ostream& os) const;
+
+    /**
+     * Reads a module back from object file form.
+     *
+     * @param text the contents of the object file
+     * @param name the name of the object file, for diagnostics
+     * @return the module
+     *
+     * @throws IOException if the text is not an object file written by this
+     * version of the compiler
+     */
+    static ObjectModule read(std::string_view text, const std::string& name);
+};
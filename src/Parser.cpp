@@ -4,24 +4,31 @@
 #include "PunchException.h"
 #include "Token.h"
 
+#include <charconv>
+
 AstProgram* Parser::parseProgram() {
     /*  program
-     *      : (fundecl | assignment)* END
+     *      : (import)* (fundecl | assignment)* END
      */
 
-    AstProgram* program = new AstProgram();
+    AstProgram* program = arena.create<AstProgram>(arena);
+
+    while (peek().type == TokenType::IMPORT) {
+        program->addImport(parseImport());
+    }
 
     while (hasNext()) {
-        if (peek().type == TokenType::FUNC) {
+        if (peek().type == TokenType::FUNC || peek().type == TokenType::AT) {
             // parse function declaration
-            auto function = std::unique_ptr<AstFunctionDecl>(parseFunction());
-            program->addFunction(std::move(function));
+            program->addFunction(parseFunction());
         } else if (peek().type == TokenType::VAR ||
                    (peek().type == TokenType::IDENT &&
                     peek(1).type == TokenType::EQUAL)) {
             // parse assignment
-            auto assignment = std::unique_ptr<AstAssignment>(parseAssignment());
-            program->addAssignment(std::move(assignment));
+            program->addAssignment(parseAssignment());
+            if (!match(TokenType::SEMICOLON)) {
+                generateError(advance(), {TokenType::SEMICOLON});
+            }
         } else {
             // neither a function definition nor an assignment - error
             generateError(advance(),
@@ -32,11 +39,48 @@ AstProgram* Parser::parseProgram() {
     return program;
 }
 
+std::string_view Parser::parseImport() {
+    /*  import
+     *      : IMPORT STRING SEMICOLON
+     */
+
+    // IMPORT
+    if (!match(TokenType::IMPORT)) {
+        generateError(advance(), {TokenType::IMPORT});
+    }
+
+    // STRING
+    Token path = advance();
+    if (path.type != TokenType::STRING) {
+        generateError(path, {TokenType::STRING});
+    }
+
+    // SEMICOLON
+    if (!match(TokenType::SEMICOLON)) {
+        generateError(advance(), {TokenType::SEMICOLON});
+    }
+
+    return copyText(path);
+}
+
 AstFunctionDecl* Parser::parseFunction() {
     /*  fundecl
-     *      : FUNC IDENT LPAREN arglist RPAREN LBRACE (stmt)* RBRACE
+     *      : (AT IDENT)* FUNC IDENT LPAREN arglist RPAREN LBRACE (stmt)* RBRACE
      */
 
+    // (AT IDENT)*
+    bool memoized = false;
+    while (match(TokenType::AT)) {
+        Token annotation = advance();
+        if (annotation.type != TokenType::IDENT) {
+            generateError(annotation, {TokenType::IDENT});
+        }
+        if (scanner.getText(annotation) != "memo") {
+            generateError(annotation, {});
+        }
+        memoized = true;
+    }
+
     // FUNC
     if (!match(TokenType::FUNC)) {
         generateError(advance(), {TokenType::FUNC});
@@ -47,14 +91,15 @@ AstFunctionDecl* Parser::parseFunction() {
     if (next.type != TokenType::IDENT) {
         generateError(next, {TokenType::IDENT});
     }
-    std::string name = next.getStringLiteral();
+    std::string_view name = copyText(next);
 
     // LPAREN
     if (!match(TokenType::LPAREN)) {
         generateError(advance(), {TokenType::LPAREN});
     }
 
-    AstFunctionDecl* function = new AstFunctionDecl(name);
+    AstFunctionDecl* function = arena.create<AstFunctionDecl>(arena, name);
+    function->setMemoized(memoized);
 
     // arglist RPAREN
     if (!match(TokenType::RPAREN)) {
@@ -67,8 +112,8 @@ AstFunctionDecl* Parser::parseFunction() {
             if (arg.type != TokenType::IDENT) {
                 generateError(advance(), {TokenType::IDENT});
             }
-            auto var = std::make_unique<AstVariable>(arg.getStringLiteral());
-            function->addArgument(std::move(var));
+            auto* var = arena.create<AstVariable>(copyText(arg));
+            function->addArgument(var);
         } while (match(TokenType::COMMA));
 
         if (!match(TokenType::RPAREN)) {
@@ -83,7 +128,7 @@ AstFunctionDecl* Parser::parseFunction() {
 
     // stmt*
     while (hasNext() && peek().type != TokenType::RBRACE) {
-        function->addStatement(std::unique_ptr<AstStatement>(parseStatement()));
+        function->addStatement(parseStatement());
     }
 
     // RBRACE
@@ -96,39 +141,29 @@ AstFunctionDecl* Parser::parseFunction() {
 
 AstAssignment* Parser::parseAssignment() {
     if (match(TokenType::VAR)) {
-        std::string ident = advance().getStringLiteral();
+        std::string_view ident = copyText(advance());
         if (!match(TokenType::EQUAL)) {
             assert(false && "expected equal sign");
         }
-        auto var = std::make_unique<AstVariable>(ident);
-        auto expr = std::unique_ptr<AstExpression>(parseExpression());
-        AstAssignment* assignment =
-            new AstAssignment(true, std::move(var), std::move(expr));
-        if (!match(TokenType::SEMICOLON)) {
-            assert(false && "expected semicolon");
-        }
-        return assignment;
+        auto* var = arena.create<AstVariable>(ident);
+        AstExpression* expr = parseExpression();
+        return arena.create<AstAssignment>(true, var, expr);
     } else if (peek().type == TokenType::IDENT) {
-        std::string ident = advance().getStringLiteral();
+        std::string_view ident = copyText(advance());
 
         if (!match(TokenType::EQUAL)) {
             assert(false && "expected equal sign");
         }
-        auto var = std::make_unique<AstVariable>(ident);
-        auto expr = std::unique_ptr<AstExpression>(parseExpression());
-        AstAssignment* assignment =
-            new AstAssignment(false, std::move(var), std::move(expr));
-        if (!match(TokenType::SEMICOLON)) {
-            assert(false && "expected semicolon");
-        }
-        return assignment;
+        auto* var = arena.create<AstVariable>(ident);
+        AstExpression* expr = parseExpression();
+        return arena.create<AstAssignment>(false, var, expr);
     } else {
         assert(false && "expected 'var' or identifier");
     }
 }
 
-AstExpression* Parser::parseExpression() {
-    if (match(TokenType::DOLLAR)) {
+AstExpression* Parser::parseExpression(AstExpression* first) {
+    if (first == nullptr && match(TokenType::DOLLAR)) {
         if (!match(TokenType::LPAREN)) {
             assert(false && "expected '('");
         }
@@ -138,40 +173,38 @@ AstExpression* Parser::parseExpression() {
         }
         return rawEnv;
     } else {
-        auto expr = parseTerm();
+        auto expr = parseTerm(first);
 
         while (peek().type == TokenType::PLUS ||
                peek().type == TokenType::MINUS) {
-            char op;
+            BinaryOperator op;
             switch (advance().type) {
-                case TokenType::PLUS: op = '+'; break;
-                case TokenType::MINUS: op = '-'; break;
+                case TokenType::PLUS: op = BinaryOperator::ADD; break;
+                case TokenType::MINUS: op = BinaryOperator::SUB; break;
                 default: assert(false && "expected binary operator");
             }
-            auto rhs = std::unique_ptr<AstExpression>(parseTerm());
-            expr = new AstBinaryExpression(
-                op, std::unique_ptr<AstExpression>(expr), std::move(rhs));
+            AstExpression* rhs = parseTerm();
+            expr = arena.create<AstBinaryExpression>(op, expr, rhs);
         }
 
         return expr;
     }
 }
 
-AstExpression* Parser::parseTerm() {
-    auto expr = parseFactor();
+AstExpression* Parser::parseTerm(AstExpression* first) {
+    auto expr = first != nullptr ? first : parseFactor();
 
     while (peek().type == TokenType::STAR || peek().type == TokenType::SLASH ||
            peek().type == TokenType::PERCENT) {
-        char op;
+        BinaryOperator op;
         switch (advance().type) {
-            case TokenType::STAR: op = '*'; break;
-            case TokenType::SLASH: op = '/'; break;
-            case TokenType::PERCENT: op = '%'; break;
+            case TokenType::STAR: op = BinaryOperator::MUL; break;
+            case TokenType::SLASH: op = BinaryOperator::DIV; break;
+            case TokenType::PERCENT: op = BinaryOperator::MOD; break;
             default: assert(false && "expected binary operator");
         }
-        auto rhs = std::unique_ptr<AstExpression>(parseFactor());
-        expr = new AstBinaryExpression(op, std::unique_ptr<AstExpression>(expr),
-                                       std::move(rhs));
+        AstExpression* rhs = parseFactor();
+        expr = arena.create<AstBinaryExpression>(op, expr, rhs);
     }
 
     return expr;
@@ -180,17 +213,23 @@ AstExpression* Parser::parseTerm() {
 AstExpression* Parser::parseFactor() {
     Token next = advance();
     if (next.type == TokenType::NUMBER) {
-        return new AstNumberLiteral(next.getNumberLiteral());
+        std::string_view digits = scanner.getText(next);
+        int64_t number = 0;
+        auto result = std::from_chars(digits.data(),
+                                      digits.data() + digits.size(), number);
+        if (result.ec != std::errc()) {
+            generateError(next, {});
+        }
+        return arena.create<AstNumberLiteral>(number);
     } else if (next.type == TokenType::STRING) {
-        return new AstStringLiteral(next.getStringLiteral());
+        return arena.create<AstStringLiteral>(copyText(next));
     } else if (next.type == TokenType::IDENT) {
         if (match(TokenType::LPAREN)) {
             AstFunctionCall* call =
-                new AstFunctionCall(next.getStringLiteral());
+                arena.create<AstFunctionCall>(arena, copyText(next));
             if (!match(TokenType::RPAREN)) {
                 do {
-                    AstExpression* arg = parseExpression();
-                    call->addArgument(std::unique_ptr<AstExpression>(arg));
+                    call->addArgument(parseExpression());
                 } while (match(TokenType::COMMA));
 
                 if (!match(TokenType::RPAREN)) {
@@ -199,27 +238,37 @@ AstExpression* Parser::parseFactor() {
             }
             return call;
         } else {
-            return new AstVariable(next.getStringLiteral());
+            return arena.create<AstVariable>(copyText(next));
         }
+    } else if (next.type == TokenType::LPAREN) {
+        AstExpression* expr = parseExpression();
+        if (!match(TokenType::RPAREN)) {
+            generateError(advance(), {TokenType::RPAREN});
+        }
+        return expr;
     } else {
-        assert(false && "unimplemented");
+        generateError(next, {TokenType::NUMBER, TokenType::STRING,
+                             TokenType::IDENT, TokenType::LPAREN});
     }
 }
 
 AstStatement* Parser::parseStatement() {
     if (peek().type == TokenType::VAR) {
-        return parseAssignment();
-    } else if (match(TokenType::FOR)) {
-        assert(false && "unimplemented");
-    } else if (match(TokenType::WHILE)) {
-        assert(false && "unimplemented");
+        AstAssignment* assignment = parseAssignment();
+        if (!match(TokenType::SEMICOLON)) {
+            assert(false && "expected semicolon");
+        }
+        return assignment;
+    } else if (peek().type == TokenType::FOR) {
+        return parseForLoop();
+    } else if (peek().type == TokenType::WHILE) {
+        return parseWhileLoop();
     } else if (peek().type == TokenType::IF) {
         return parseConditional();
     } else if (peek().type == TokenType::LBRACE) {
         return parseStatementBlock();
     } else if (match(TokenType::RETURN)) {
-        auto expr = std::unique_ptr<AstExpression>(parseExpression());
-        AstReturn* result = new AstReturn(std::move(expr));
+        AstReturn* result = arena.create<AstReturn>(parseExpression());
         if (!match(TokenType::SEMICOLON)) {
             assert(false && "expected ';'");
         }
@@ -235,7 +284,11 @@ AstStatement* Parser::parseStatement() {
         return rawEnv;
     } else if (peek().type == TokenType::IDENT &&
                peek(1).type == TokenType::EQUAL) {
-        return parseAssignment();
+        AstAssignment* assignment = parseAssignment();
+        if (!match(TokenType::SEMICOLON)) {
+            assert(false && "expected semicolon");
+        }
+        return assignment;
     } else {
         AstExpression* expr = parseExpression();
         if (!match(TokenType::SEMICOLON)) {
@@ -250,10 +303,9 @@ AstStatementBlock* Parser::parseStatementBlock() {
         assert(false && "expected '{'");
     }
 
-    auto* stmtBlock = new AstStatementBlock();
+    auto* stmtBlock = arena.create<AstStatementBlock>(arena);
     while (!match(TokenType::RBRACE)) {
-        auto stmt = std::unique_ptr<AstStatement>(parseStatement());
-        stmtBlock->appendStatement(std::move(stmt));
+        stmtBlock->appendStatement(parseStatement());
     }
 
     return stmtBlock;
@@ -268,69 +320,217 @@ AstConditional* Parser::parseConditional() {
         assert(false && "expected '('");
     }
 
-    auto cond = std::unique_ptr<AstCondition>(parseCondition());
+    AstCondition* cond = parseCondition();
 
     if (!match(TokenType::RPAREN)) {
         assert(false && "expected ')'");
     }
 
-    auto ifStmt = std::unique_ptr<AstStatement>(parseStatement());
+    AstStatement* ifStmt = parseStatement();
 
     if (match(TokenType::ELSE)) {
-        auto elseStmt = std::unique_ptr<AstStatement>(parseStatement());
-        return new AstBranchingConditional(std::move(cond), std::move(ifStmt),
-                                           std::move(elseStmt));
+        AstStatement* elseStmt = parseStatement();
+        return arena.create<AstBranchingConditional>(cond, ifStmt, elseStmt);
     } else {
-        return new AstSimpleConditional(std::move(cond), std::move(ifStmt));
+        return arena.create<AstSimpleConditional>(cond, ifStmt);
     }
 }
 
-AstCondition* Parser::parseCondition() {
+AstLoop* Parser::parseForLoop() {
+    /*  loop
+     *      : FOR LPAREN (assignment | expr) SEMICOLON condition SEMICOLON
+     *        (assignment | expr) RPAREN LBRACE (stmt)* RBRACE
+     */
+
+    if (!match(TokenType::FOR)) {
+        generateError(advance(), {TokenType::FOR});
+    }
+    if (!match(TokenType::LPAREN)) {
+        generateError(advance(), {TokenType::LPAREN});
+    }
+
+    AstStatement* init = parseSimpleStatement();
+    if (!match(TokenType::SEMICOLON)) {
+        generateError(advance(), {TokenType::SEMICOLON});
+    }
+
+    AstCondition* cond = parseCondition();
+    if (!match(TokenType::SEMICOLON)) {
+        generateError(advance(), {TokenType::SEMICOLON});
+    }
+
+    AstStatement* step = parseSimpleStatement();
+    if (!match(TokenType::RPAREN)) {
+        generateError(advance(), {TokenType::RPAREN});
+    }
+
+    if (peek().type != TokenType::LBRACE) {
+        generateError(advance(), {TokenType::LBRACE});
+    }
+    AstStatementBlock* body = parseStatementBlock();
+
+    return arena.create<AstForLoop>(init, cond, step, body);
+}
+
+AstLoop* Parser::parseWhileLoop() {
+    /*  loop
+     *      : WHILE LPAREN condition RPAREN LBRACE (stmt)* RBRACE
+     */
+
+    if (!match(TokenType::WHILE)) {
+        generateError(advance(), {TokenType::WHILE});
+    }
+    if (!match(TokenType::LPAREN)) {
+        generateError(advance(), {TokenType::LPAREN});
+    }
+
+    AstCondition* cond = parseCondition();
+    if (!match(TokenType::RPAREN)) {
+        generateError(advance(), {TokenType::RPAREN});
+    }
+
+    if (peek().type != TokenType::LBRACE) {
+        generateError(advance(), {TokenType::LBRACE});
+    }
+    AstStatementBlock* body = parseStatementBlock();
+
+    return arena.create<AstWhileLoop>(cond, body);
+}
+
+AstStatement* Parser::parseSimpleStatement() {
+    if (peek().type == TokenType::VAR ||
+        (peek().type == TokenType::IDENT &&
+         peek(1).type == TokenType::EQUAL)) {
+        return parseAssignment();
+    }
+    return parseExpression();
+}
+
+AstCondition* Parser::parseCondition(AstCondition* first) {
     // TODO: maybe make conditions expressions?
+    auto cond = parseConjunction(first);
+
+    while (match(TokenType::LOR)) {
+        AstCondition* rhs = parseConjunction();
+        cond = arena.create<AstDisjunction>(cond, rhs);
+    }
+
+    return cond;
+}
+
+AstCondition* Parser::parseConjunction(AstCondition* first) {
+    auto cond = first != nullptr ? first : parseNegation();
+
+    while (match(TokenType::LAND)) {
+        AstCondition* rhs = parseNegation();
+        cond = arena.create<AstConjunction>(cond, rhs);
+    }
+
+    return cond;
+}
+
+AstCondition* Parser::parseNegation() {
+    if (match(TokenType::LNOT)) {
+        return arena.create<AstNegation>(parseNegation());
+    }
+    return parseComparison();
+}
+
+AstCondition* Parser::parseComparison() {
     if (match(TokenType::TRUEVAL)) {
-        return new AstTrue();
+        return arena.create<AstTrue>();
     } else if (match(TokenType::FALSEVAL)) {
-        return new AstFalse();
-    } else if (match(TokenType::LNOT)) {
-        assert(false && "unimplemented");
+        return arena.create<AstFalse>();
     } else if (match(TokenType::LPAREN)) {
-        auto* cond = parseCondition();
+        AstNode* inner = parseGrouping();
         if (!match(TokenType::RPAREN)) {
-            assert(false && "expected ')'");
+            generateError(advance(), {TokenType::RPAREN});
+        }
+        if (auto* cond = dyn_cast<AstCondition>(inner)) {
+            return cond;
         }
-        return cond;
+
+        // a parenthesised expression starts the left-hand side
+        AstExpression* lhs = parseExpression(cast<AstExpression>(inner));
+        return parseComparisonTail(lhs);
     } else {
-        auto lhs = std::unique_ptr<AstExpression>(parseExpression());
-        std::string op;
-        switch (advance().type) {
-            case TokenType::LEQ: op = "<="; break;
-            case TokenType::GEQ: op = ">="; break;
-            case TokenType::EQUALEQUAL: op = "=="; break;
-            case TokenType::LESSTHAN: op = "<"; break;
-            case TokenType::GREATERTHAN: op = ">"; break;
-            default: assert(false && "unexpected comparator");
+        return parseComparisonTail(parseExpression());
+    }
+}
+
+AstNode* Parser::parseGrouping() {
+    AstExpression* lhs;
+    if (match(TokenType::LPAREN)) {
+        AstNode* inner = parseGrouping();
+        if (!match(TokenType::RPAREN)) {
+            generateError(advance(), {TokenType::RPAREN});
         }
-        auto rhs = std::unique_ptr<AstExpression>(parseExpression());
+        if (auto* cond = dyn_cast<AstCondition>(inner)) {
+            return parseCondition(cond);
+        }
+        lhs = parseExpression(cast<AstExpression>(inner));
+    } else if (peek().type == TokenType::LNOT ||
+               peek().type == TokenType::TRUEVAL ||
+               peek().type == TokenType::FALSEVAL) {
+        return parseCondition();
+    } else {
+        lhs = parseExpression();
+    }
+
+    // only a comparison turns an expression into a condition
+    if (!isComparisonOperator(peek().type)) {
+        return lhs;
+    }
+    return parseCondition(parseComparisonTail(lhs));
+}
 
-        return new AstBinaryComparison(op, std::move(lhs), std::move(rhs));
+AstCondition* Parser::parseComparisonTail(AstExpression* lhs) {
+    ComparisonOperator op;
+    Token next = advance();
+    switch (next.type) {
+        case TokenType::LEQ: op = ComparisonOperator::LE; break;
+        case TokenType::GEQ: op = ComparisonOperator::GE; break;
+        case TokenType::EQUALEQUAL: op = ComparisonOperator::EQ; break;
+        case TokenType::NOTEQUAL: op = ComparisonOperator::NE; break;
+        case TokenType::LESSTHAN: op = ComparisonOperator::LT; break;
+        case TokenType::GREATERTHAN: op = ComparisonOperator::GT; break;
+        default:
+            generateError(next, {TokenType::LEQ, TokenType::GEQ,
+                                 TokenType::EQUALEQUAL, TokenType::NOTEQUAL,
+                                 TokenType::LESSTHAN,
+                                 TokenType::GREATERTHAN});
+    }
+    AstExpression* rhs = parseExpression();
+
+    return arena.create<AstBinaryComparison>(op, lhs, rhs);
+}
+
+bool Parser::isComparisonOperator(TokenType type) {
+    switch (type) {
+        case TokenType::LEQ:
+        case TokenType::GEQ:
+        case TokenType::EQUALEQUAL:
+        case TokenType::NOTEQUAL:
+        case TokenType::LESSTHAN:
+        case TokenType::GREATERTHAN: return true;
+        default: return false;
     }
 }
 
 AstRawEnvironment* Parser::parseRawEnvironment() {
-    AstRawEnvironment* rawEnv = new AstRawEnvironment();
+    AstRawEnvironment* rawEnv = arena.create<AstRawEnvironment>(arena);
     while (peek().type == TokenType::RAWEXPR ||
            peek().type == TokenType::DOLLAR) {
         if (peek().type == TokenType::RAWEXPR) {
-            std::string expr = advance().getStringLiteral();
-            rawEnv->addRawExpression(
-                std::make_unique<AstRawBashExpression>(expr));
+            std::string_view expr = copyText(advance());
+            rawEnv->addRawExpression(arena.create<AstRawBashExpression>(expr));
         } else if (match(TokenType::DOLLAR)) {
             if (!match(TokenType::LBRACKET)) {
                 assert(false && "expected '['");
             }
-            auto expression = std::unique_ptr<AstExpression>(parseExpression());
+            AstExpression* expression = parseExpression();
             rawEnv->addRawExpression(
-                std::make_unique<AstRawPunchExpression>(std::move(expression)));
+                arena.create<AstRawPunchExpression>(expression));
             if (!match(TokenType::RBRACKET)) {
                 assert(false && "expected ']'");
             }
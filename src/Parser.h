@@ -1,29 +1,50 @@
 #pragma once
 
+#include "AstArena.h"
 #include "AstProgram.h"
 #include "AstStatement.h"
 #include "PunchException.h"
+#include "Scanner.h"
 #include "Token.h"
 
+#include <array>
+#include <string_view>
 #include <vector>
 
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens) : idx(0), tokens(tokens) {}
+    Parser(Scanner& scanner, AstArena& arena)
+        : scanner(scanner), arena(arena), lookaheadStart(0), lookaheadSize(0) {
+    }
 
     AstProgram* parse() { return parseProgram(); }
 
     bool hasNext() { return peek().type != TokenType::END; }
 
-    Token advance() { return tokens[idx++]; }
-
-    Token peek() const { return peek(0); }
+    Token advance() {
+        Token token = peek();
+        lookaheadStart = (lookaheadStart + 1) % LOOKAHEAD;
+        lookaheadSize--;
+        return token;
+    }
 
-    Token peek(size_t count) const {
-        if (idx + count >= tokens.size()) {
-            return Token(TokenType::END, 0, 0);
+    const Token& peek() { return peek(0); }
+
+    /**
+     * Gets an upcoming token without consuming it, pulling tokens from the
+     * scanner as needed.
+     *
+     * @param count the number of tokens to look past
+     * @return a reference to the token, valid until the parser next advances
+     */
+    const Token& peek(size_t count) {
+        assert(count < LOOKAHEAD && "lookahead exceeds buffer");
+        while (lookaheadSize <= count) {
+            lookahead[(lookaheadStart + lookaheadSize) % LOOKAHEAD] =
+                scanner.next();
+            lookaheadSize++;
         }
-        return tokens[idx + count];
+        return lookahead[(lookaheadStart + count) % LOOKAHEAD];
     }
 
     bool match(TokenType type) {
@@ -36,15 +57,43 @@ public:
     }
 
 private:
-    int idx;
-    const std::vector<Token>& tokens;
+    static constexpr size_t LOOKAHEAD = 4;
+
+    Scanner& scanner;
+    AstArena& arena;
+
+    // ring buffer of tokens pulled from the scanner but not yet consumed
+    std::array<Token, LOOKAHEAD> lookahead;
+    size_t lookaheadStart;
+    size_t lookaheadSize;
+
+    /**
+     * Copies the text of a token into the AST arena.
+     *
+     * @param token the token whose text should be copied
+     * @return a view of the copied text, owned by the arena
+     */
+    std::string_view copyText(const Token& token) {
+        return arena.copyString(scanner.getText(token));
+    }
 
     AstProgram* parseProgram();
 
+    /**
+     * Parses an import, giving the path of the imported module as written.
+     */
+    std::string_view parseImport();
+
     AstAssignment* parseAssignment();
 
-    AstExpression* parseExpression();
-    AstExpression* parseTerm();
+    /**
+     * Parses an expression, or the rest of one whose first operand has
+     * already been parsed.
+     *
+     * @param first the first operand, or null to parse the whole expression
+     */
+    AstExpression* parseExpression(AstExpression* first = nullptr);
+    AstExpression* parseTerm(AstExpression* first = nullptr);
     AstExpression* parseFactor();
 
     AstFunctionDecl* parseFunction();
@@ -55,17 +104,49 @@ private:
 
     AstConditional* parseConditional();
 
-    AstCondition* parseCondition();
+    AstLoop* parseForLoop();
+    AstLoop* parseWhileLoop();
+
+    /**
+     * Parses an assignment or an expression, without a trailing semicolon.
+     */
+    AstStatement* parseSimpleStatement();
+
+    /**
+     * Parses a condition, or the rest of one whose first operand has already
+     * been parsed.
+     *
+     * @param first the first operand, or null to parse the whole condition
+     */
+    AstCondition* parseCondition(AstCondition* first = nullptr);
+    AstCondition* parseConjunction(AstCondition* first = nullptr);
+    AstCondition* parseNegation();
+    AstCondition* parseComparison();
+
+    /**
+     * Parses what follows an opening parenthesis within a condition, up to
+     * the closing one. The two cannot be told apart up front, so this gives
+     * either a condition, or an expression to be continued as the left-hand
+     * side of a comparison.
+     */
+    AstNode* parseGrouping();
+
+    /**
+     * Parses the operator and right-hand side of a comparison.
+     */
+    AstCondition* parseComparisonTail(AstExpression* lhs);
+
+    static bool isComparisonOperator(TokenType type);
 
     AstRawEnvironment* parseRawEnvironment();
 
     // TODO: clean up error generation
-    void generateError(Token seen, std::vector<TokenType> expected) {
-        ParserException exc =
-            expected.empty()
-                ? ParserException(seen.type, seen.line, seen.col)
-                : ParserException(seen.type, expected, seen.line, seen.col);
-        PunchException::handleException(exc);
-        exit(1);
+    [[noreturn]] void generateError(Token seen,
+                                    std::vector<TokenType> expected) {
+        SourceLocation loc = scanner.getLocation(seen.offset);
+        if (expected.empty()) {
+            throw ParserException(seen.type, loc.line, loc.col);
+        }
+        throw ParserException(seen.type, expected, loc.line, loc.col);
     }
 };
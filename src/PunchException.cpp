@@ -3,10 +3,20 @@
 #include <iostream>
 
 void PunchException::handleException(const PunchException& e) {
+    std::cout << describe(e) << std::endl;
+}
+
+std::string PunchException::describe(const PunchException& e) {
     if (dynamic_cast<const ScannerException*>(&e) != nullptr) {
-        std::cout << "Scanner error: " << e.getMessage();
+        return "Scanner error: " + e.getMessage();
     } else if (dynamic_cast<const ParserException*>(&e) != nullptr) {
-        std::cout << "Parser error: " << e.getMessage();
+        return "Parser error: " + e.getMessage();
+    } else if (dynamic_cast<const SemanticException*>(&e) != nullptr) {
+        return "Semantic error: " + e.getMessage();
+    } else if (dynamic_cast<const LinkException*>(&e) != nullptr) {
+        return "Link error: " + e.getMessage();
+    } else if (dynamic_cast<const IOException*>(&e) != nullptr) {
+        return "I/O error: " + e.getMessage();
     }
-    std::cout << std::endl;
+    return e.getMessage();
 }
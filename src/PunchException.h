@@ -11,6 +11,14 @@ class PunchException : public std::exception {
 public:
     static void handleException(const PunchException& e);
 
+    /**
+     * Formats an exception as a single-line error report.
+     *
+     * @param e the exception to describe
+     * @return the message, prefixed with the stage the error came from
+     */
+    static std::string describe(const PunchException& e);
+
     virtual std::string getMessage() const = 0;
 };
 
@@ -84,3 +92,55 @@ public:
 private:
     std::string msg;
 };
+
+class SemanticException : public PunchException {
+public:
+    SemanticException(std::string msg) : msg(msg) {}
+
+    virtual std::string getMessage() const { return msg; }
+
+    const char* what() const throw() { return msg.c_str(); }
+
+private:
+    std::string msg;
+};
+
+class LinkException : public PunchException {
+public:
+    LinkException(std::string msg) : msg(msg) {}
+
+    virtual std::string getMessage() const { return msg; }
+
+    const char* what() const throw() { return msg.c_str(); }
+
+private:
+    std::string msg;
+};
+
+class IOException : public PunchException {
+public:
+    IOException(std::string msg) : msg(msg) {}
+
+    virtual std::string getMessage() const { return msg; }
+
+    const char* what() const throw() { return msg.c_str(); }
+
+private:
+    std::string msg;
+};
+
+/**
+ * Error relayed from a compile server, whose message already says which stage
+ * it came from.
+ */
+class RemoteException : public PunchException {
+public:
+    RemoteException(std::string msg) : msg(msg) {}
+
+    virtual std::string getMessage() const { return msg; }
+
+    const char* what() const throw() { return msg.c_str(); }
+
+private:
+    std::string msg;
+};
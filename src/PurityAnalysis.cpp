@@ -0,0 +1,94 @@
+#include "PurityAnalysis.h"
+#include "AstFunction.h"
+
+#include <unordered_map>
+
+namespace {
+
+using NameSet = std::unordered_set<std::string_view>;
+
+/**
+ * Gathers what a single function does itself, leaving aside its callees.
+ */
+class EffectCollector : public AstNodeMapper {
+public:
+    EffectCollector(NameSet& declared, NameSet& used, NameSet& callees,
+                    bool& raw)
+        : declared(declared), used(used), callees(callees), raw(raw) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* assignment = dyn_cast<AstAssignment>(node)) {
+            if (assignment->isDeclaration()) {
+                declared.insert(assignment->getVariable()->getName());
+            }
+        } else if (const auto* var = dyn_cast<AstVariable>(node)) {
+            used.insert(var->getName());
+        } else if (const auto* call = dyn_cast<AstFunctionCall>(node)) {
+            callees.insert(call->getName());
+        } else if (isa<AstRawEnvironment>(node)) {
+            raw = true;
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    NameSet& declared;
+    NameSet& used;
+    NameSet& callees;
+    bool& raw;
+};
+
+} // namespace
+
+PurityAnalysis::PurityAnalysis(AstProgram* program) {
+    std::unordered_map<std::string_view, NameSet> calls;
+    NameSet redefined;
+
+    for (auto* function : program->getFunctions()) {
+        NameSet declared;
+        NameSet used;
+        NameSet callees;
+        bool raw = false;
+        for (const auto* param : function->getArguments()) {
+            declared.insert(param->getName());
+        }
+        function->apply(EffectCollector(declared, used, callees, raw));
+
+        // any other variable is a global, shared with the rest of the script
+        bool local = !raw;
+        for (auto name : used) {
+            local = local && declared.count(name) != 0;
+        }
+
+        std::string_view name = function->getName();
+        if (!calls.emplace(name, std::move(callees)).second) {
+            redefined.insert(name);
+        }
+        if (local) {
+            pure.insert(name);
+        }
+    }
+    for (auto name : redefined) {
+        pure.erase(name);
+    }
+
+    // drop callers of impure functions, and of commands that are not punch
+    // functions at all, until nothing changes
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = pure.begin(); it != pure.end();) {
+            bool callsPure = true;
+            for (auto callee : calls[*it]) {
+                callsPure = callsPure && pure.count(callee) != 0;
+            }
+            if (callsPure) {
+                ++it;
+            } else {
+                it = pure.erase(it);
+                changed = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "AstNode.h"
+#include "AstProgram.h"
+
+#include <string_view>
+#include <unordered_set>
+
+/**
+ * Analysis finding the functions whose result depends only on their
+ * arguments, and which have no effect beyond producing it.
+ *
+ * A function is pure if it contains no raw code, touches no variables other
+ * than its parameters and its own locals, and calls only pure functions.
+ * Purity is computed as the largest such set over the call graph, so
+ * recursive functions can be pure. Functions defined more than once are
+ * never pure, since a call may reach either definition.
+ */
+class PurityAnalysis {
+public:
+    /**
+     * Analyses every function in a program.
+     */
+    PurityAnalysis(AstProgram* program);
+
+    /**
+     * Checks whether the function with the given name is pure.
+     */
+    bool isPure(std::string_view name) const { return pure.count(name) != 0; }
+
+private:
+    std::unordered_set<std::string_view> pure;
+};
@@ -1,14 +1,56 @@
 #include "Scanner.h"
+#include "CharScan.h"
 #include "Token.h"
 
+#include <algorithm>
 #include <vector>
 
+SourceLocation Scanner::getLocation(size_t offset) const {
+    if (lineOffsets.empty()) {
+        lineOffsets.push_back(0);
+        for (size_t i = 0; i < source.length(); i++) {
+            if (source[i] == '\n') {
+                lineOffsets.push_back(i + 1);
+            }
+        }
+    }
+
+    // find the last line starting at or before the offset
+    auto pos = std::upper_bound(lineOffsets.begin(), lineOffsets.end(), offset);
+    size_t line = pos - lineOffsets.begin();
+    return SourceLocation{line, offset - lineOffsets[line - 1] + 1};
+}
+
+void Scanner::scanStep() {
+    if (!rawEnvironments.empty() && !rawEnvironments.back().inPunch) {
+        scanRawChunk();
+        return;
+    }
+
+    // jump over any whitespace before the next token
+    const char* data = source.data();
+    idx = CharScan::skipWhitespace(data + idx, data + source.length()) - data;
+
+    if (!hasNext()) {
+        if (!rawEnvironments.empty()) {
+            generateError("unterminated raw environment",
+                          rawEnvironments.back().envStart);
+        }
+        currTokenStart = idx;
+        addToken(TokenType::END);
+        return;
+    }
+
+    currTokenStart = idx;
+    scanToken();
+}
+
 void Scanner::scanToken() {
     char chr = advance();
 
     switch (chr) {
         // whitespace
-        case '\n': line += 1; col = 0;
+        case '\n':
         case ' ':
         case '\t':
         case '\r': break;
@@ -24,8 +66,18 @@ void Scanner::scanToken() {
         case '*': addToken(TokenType::STAR); break;
         case '%': addToken(TokenType::PERCENT); break;
         case '[': addToken(TokenType::LBRACKET); break;
-        case ']': addToken(TokenType::RBRACKET); break;
+        case ']': {
+            addToken(TokenType::RBRACKET);
+
+            // a ']' closes a punch expression nested in a raw environment
+            if (!rawEnvironments.empty() && rawEnvironments.back().inPunch) {
+                rawEnvironments.back().inPunch = false;
+                rawEnvironments.back().chunkStart = idx;
+            }
+            break;
+        }
         case ',': addToken(TokenType::COMMA); break;
+        case '@': addToken(TokenType::AT); break;
         case '~': addToken(TokenType::BNOT); break;
 
         // possibly multi-character simple tokens
@@ -48,7 +100,7 @@ void Scanner::scanToken() {
         }
 
         case '>': {
-            if (match('>')) {
+            if (match('=')) {
                 addToken(TokenType::GEQ);
             } else {
                 addToken(TokenType::GREATERTHAN);
@@ -96,7 +148,7 @@ void Scanner::scanToken() {
         case '"': scanString(); break;
         case '$': {
             addToken(TokenType::DOLLAR);
-            scanRawEnvironment('(', ')');
+            enterRawEnvironment('(', ')');
             break;
         }
 
@@ -107,7 +159,7 @@ void Scanner::scanToken() {
                 scanIdentifier();
             } else {
                 // unexpected character
-                generateError(chr, line, col);
+                generateError(chr, idx - 1);
             }
         }
     }
@@ -122,50 +174,95 @@ void Scanner::scanString() {
     }
 
     // read in the final '"' character
-    advance();
+    if (!match('"')) {
+        generateError("unterminated string", currTokenStart);
+    }
 
     // the string is everything except the surrounding '"' characters
-    std::string result =
-        source.substr(currTokenStart + 1, idx - currTokenStart - 2);
-    addToken(TokenType::STRING, result);
+    addToken(TokenType::STRING, currTokenStart + 1, idx - 1);
 }
 
+namespace {
+
+/**
+ * Locale-independent equivalent of isalnum for the ASCII identifier
+ * characters, cheap enough to inline into the scanning loop.
+ */
+inline bool isAlphanumeric(char chr) {
+    return (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') ||
+           (chr >= '0' && chr <= '9');
+}
+
+/**
+ * Classifies an identifier as a keyword or a plain identifier.
+ *
+ * Dispatches on the length and first character of the word, so at most one
+ * full comparison is made.
+ *
+ * @param word the identifier to classify
+ * @return the keyword's token type, or IDENT if the word is not a keyword
+ */
+TokenType getKeywordType(std::string_view word) {
+    auto check = [&](std::string_view keyword, TokenType type) {
+        return word == keyword ? type : TokenType::IDENT;
+    };
+
+    switch (word.size()) {
+        case 2: return check("if", TokenType::IF);
+        case 3: {
+            switch (word[0]) {
+                case 'f': return check("for", TokenType::FOR);
+                case 'r': return check("raw", TokenType::RAW);
+                case 'v': return check("var", TokenType::VAR);
+            }
+            break;
+        }
+        case 4: {
+            switch (word[0]) {
+                case 'e': return check("else", TokenType::ELSE);
+                case 'f': return check("func", TokenType::FUNC);
+                case 't': return check("true", TokenType::TRUEVAL);
+            }
+            break;
+        }
+        case 5: {
+            switch (word[0]) {
+                case 'f': return check("false", TokenType::FALSEVAL);
+                case 'w': return check("while", TokenType::WHILE);
+            }
+            break;
+        }
+        case 6: {
+            switch (word[0]) {
+                case 'i': return check("import", TokenType::IMPORT);
+                case 'r': return check("return", TokenType::RETURN);
+            }
+            break;
+        }
+    }
+
+    return TokenType::IDENT;
+}
+
+} // namespace
+
 void Scanner::scanIdentifier() {
     // keep reading in contiguous alphanumeric characters
     // TODO: check that isalnum is what is expected
-    while (hasNext() && isalnum(peek())) {
-        advance();
+    const char* pos = source.data() + idx;
+    const char* end = source.data() + source.length();
+    while (pos != end && isAlphanumeric(*pos)) {
+        pos++;
     }
-
-    std::string result = source.substr(currTokenStart, idx - currTokenStart);
+    idx = pos - source.data();
 
     // match with a keyword if possible
-    if (result == "var") {
-        addToken(TokenType::VAR);
-    } else if (result == "func") {
-        addToken(TokenType::FUNC);
-    } else if (result == "if") {
-        addToken(TokenType::IF);
-    } else if (result == "else") {
-        addToken(TokenType::ELSE);
-    } else if (result == "for") {
-        addToken(TokenType::FOR);
-    } else if (result == "while") {
-        addToken(TokenType::WHILE);
-    } else if (result == "$") {
-        addToken(TokenType::DOLLAR);
-    } else if (result == "raw") {
-        addToken(TokenType::RAW);
-        scanRawEnvironment('{', '}');
-    } else if (result == "return") {
-        addToken(TokenType::RETURN);
-    } else if (result == "true") {
-        addToken(TokenType::TRUEVAL);
-    } else if (result == "false") {
-        addToken(TokenType::FALSEVAL);
-    } else {
-        // otherwise, it is an identifier
-        addToken(TokenType::IDENT, result);
+    TokenType type =
+        getKeywordType(source.substr(currTokenStart, idx - currTokenStart));
+    addToken(type);
+
+    if (type == TokenType::RAW) {
+        enterRawEnvironment('{', '}');
     }
 }
 
@@ -175,93 +272,110 @@ void Scanner::scanNumber() {
         advance();
     }
 
-    std::string result = source.substr(currTokenStart, idx - currTokenStart);
-    int number = std::stoi(result);
-    addToken(TokenType::NUMBER, number);
+    // the value is parsed straight from the source text when needed
+    addToken(TokenType::NUMBER);
 }
 
 void Scanner::scanComment() {
     // TODO: assumes first char already scnaned
+    const char* data = source.data();
+    const char* end = data + source.length();
+
     if (match('/')) {
-        while (hasNext() && peek() != '\n') {
-            advance();
-        }
+        // skip to the end of the line
+        idx = CharScan::findChar(data + idx, end, '\n') - data;
     } else if (match('*')) {
         // TODO: support nested multiline comments
-        while (hasNext()) {
-            if (match('*')) {
-                if (peek() == '/') {
-                    return;
-                }
-            } else {
-                advance();
+        const char* pos = data + idx;
+        while (true) {
+            pos = CharScan::findChar(pos, end, '*');
+            if (pos == end || ++pos == end) {
+                break;
+            }
+            if (*pos == '/') {
+                // consume the closing '/'
+                pos++;
+                break;
             }
         }
+        idx = pos - data;
     }
 }
 
-void Scanner::scanRawEnvironment(char start, char end) {
+void Scanner::enterRawEnvironment(char start, char end) {
     // TODO: currently ignoring everything until start character; fix this
     while (hasNext() && peek() != start) {
         advance();
     }
-    assert(advance() == start && "expected start symbol");
+    if (!match(start)) {
+        generateError(std::string("expected '") + start + "'", idx);
+    }
 
     // add the start token
     switch (start) {
-        case '{': addToken(TokenType::LBRACE); break;
-        case '(': addToken(TokenType::LPAREN); break;
+        case '{': addToken(TokenType::LBRACE, idx - 1, idx); break;
+        case '(': addToken(TokenType::LPAREN, idx - 1, idx); break;
         default: assert(false && "unexpected start of raw environment");
     }
 
-    int startIdx = idx;
-    int nestingLevel = 1;
+    rawEnvironments.push_back(
+        RawEnvironment{start, end, 1, idx - 1, idx, false});
+}
+
+void Scanner::scanRawChunk() {
+    RawEnvironment& env = rawEnvironments.back();
+    const char* data = source.data();
+    const char* end = data + source.length();
+
+    while (true) {
+        // jump straight to the next character that could matter
+        const char* pos = CharScan::findFirstOf(data + idx, end, env.start,
+                                                env.end, '$');
+        idx = pos - data;
+        if (!hasNext()) {
+            break;
+        }
 
-    while (hasNext()) {
         char chr = advance();
-        if (chr == start) {
-            nestingLevel++;
-        } else if (chr == end) {
-            nestingLevel--;
-            if (nestingLevel == 0) {
+        if (chr == env.start) {
+            env.nestingLevel++;
+        } else if (chr == env.end) {
+            env.nestingLevel--;
+            if (env.nestingLevel == 0) {
                 // finished with the raw environment!
-                break;
+                // add in the final raw expression block, ignoring the end
+                // character
+                addToken(TokenType::RAWEXPR, env.chunkStart, idx - 1);
+
+                // add in the end token
+                TokenType endType;
+                switch (env.end) {
+                    case '}': endType = TokenType::RBRACE; break;
+                    case ')': endType = TokenType::RPAREN; break;
+                    default: assert(false && "unexpected end of raw environment");
+                }
+                addToken(endType, idx - 1, idx);
+
+                rawEnvironments.pop_back();
+                return;
             }
         } else if (chr == '$' && match('[')) {
             // hit a nested punch expression!
 
             // add everything read so far as a block of raw expressions
             // '$[' should be removed
-            std::string result = source.substr(startIdx, idx - startIdx - 2);
-            addToken(TokenType::RAWEXPR, result);
+            addToken(TokenType::RAWEXPR, env.chunkStart, idx - 2);
 
             // add in the '$[' tokens
-            addToken(TokenType::DOLLAR);
-            addToken(TokenType::LBRACKET);
+            addToken(TokenType::DOLLAR, idx - 2, idx - 1);
+            addToken(TokenType::LBRACKET, idx - 1, idx);
 
             // keep scanning in tokens as if in a regular punch environment,
             // until the nested expression is terminated (with a ']')
-            Token* token = &tokens[tokens.size() - 1];
-            while (token->type != TokenType::RBRACKET) {
-                currTokenStart = idx;
-                scanToken();
-                token = &tokens[tokens.size() - 1];
-            }
-
-            // raw block now starts from current index
-            startIdx = idx;
+            env.inPunch = true;
+            return;
         }
     }
 
-    // add in the final raw expression block
-    // end character should be ignored
-    std::string result = source.substr(startIdx, idx - startIdx - 1);
-    addToken(TokenType::RAWEXPR, result);
-
-    // add in the end token
-    switch (end) {
-        case '}': addToken(TokenType::RBRACE); break;
-        case ')': addToken(TokenType::RPAREN); break;
-        default: assert(false && "unexpected end of raw environment");
-    }
+    generateError("unterminated raw environment", env.envStart);
 }
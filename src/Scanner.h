@@ -3,41 +3,105 @@
 #include "PunchException.h"
 #include "Token.h"
 
+#include <cstdint>
+#include <string>
+#include <string_view>
 #include <vector>
 
+/**
+ * A human-readable position within the source.
+ */
+struct SourceLocation {
+    size_t line;
+    size_t col;
+};
+
 class Scanner {
 public:
-    Scanner(std::string source)
-        : source(source), idx(0), currTokenStart(0), tokens({}), line(1),
-          col(0) {
-        while (hasNext()) {
-            currTokenStart = idx;
-            scanToken();
+    /**
+     * Scans the given source in place.
+     *
+     * @param source the source text, which must outlive the scanner
+     */
+    Scanner(std::string_view source)
+        : source(source), idx(0), currTokenStart(0), pendingIdx(0) {}
+
+    /**
+     * Scans the next token in the source, on demand.
+     *
+     * @return the next token; once the source is exhausted, an END token is
+     * returned on every call
+     */
+    Token next() {
+        while (pendingIdx == pending.size()) {
+            pending.clear();
+            pendingIdx = 0;
+            scanStep();
         }
-        addToken(TokenType::END);
+        return pending[pendingIdx++];
     }
 
     /**
-     * Checks whether any tokens remain to be scanned.
+     * Checks whether any characters remain to be scanned.
      *
-     * @return true iff any more tokens can be scanned
+     * @return true iff the end of the source has not been reached
      */
     bool hasNext() const { return idx < source.length(); }
 
     /**
-     * Gets the final list of tokens from the scanner.
+     * Gets the source text spanned by a token.
      *
-     * @return a vector of scanned tokens
+     * @param token the token to look up
+     * @return a view into the source, valid for the lifetime of the scanner
      */
-    const std::vector<Token>& getTokens() const { return tokens; }
+    std::string_view getText(const Token& token) const {
+        return source.substr(token.offset, token.length);
+    }
+
+    /**
+     * Converts a source offset into a line and column.
+     *
+     * @param offset the offset into the source
+     * @return the 1-indexed line and column of the offset
+     *
+     * @note the line index is only built on the first call, so this is
+     * intended for diagnostics rather than the scanning hot path
+     */
+    SourceLocation getLocation(size_t offset) const;
 
 private:
-    std::string source;
+    static constexpr size_t MAX_TOKEN_LENGTH = UINT32_MAX;
+
+    /**
+     * State of a raw environment that is currently being scanned.
+     */
+    struct RawEnvironment {
+        char start;
+        char end;
+        int nestingLevel;
+
+        // offset of the start marker, for diagnostics
+        size_t envStart;
+
+        // offset of the first raw character not yet emitted as a token
+        size_t chunkStart;
+
+        // whether the scanner is inside a nested '$[...]' punch expression
+        bool inPunch;
+    };
+
+    std::string_view source;
     size_t idx;
     size_t currTokenStart;
-    std::vector<Token> tokens;
-    size_t line;
-    size_t col;
+
+    // tokens produced by the last scanning step, not yet handed out
+    std::vector<Token> pending;
+    size_t pendingIdx;
+
+    // raw environments enclosing the current position, innermost last
+    std::vector<RawEnvironment> rawEnvironments;
+
+    mutable std::vector<size_t> lineOffsets;
 
     /**
      * Advances the scanner by one character.
@@ -45,17 +109,19 @@ private:
      * @return the character that was pointed to by the scanner
      */
     char advance() {
-        col += 1;
-        return source[idx++];
+        char chr = peek();
+        idx++;
+        return chr;
     }
 
     /**
      * Gets the current character in the source string, without advancing the
      * scanner.
      *
-     * @return the current character pointed to by the scanner
+     * @return the current character pointed to by the scanner, or '\0' once
+     * the end of the source has been reached
      */
-    char peek() { return source[idx]; }
+    char peek() const { return hasNext() ? source[idx] : '\0'; }
 
     /**
      * Advances the scanner iff the current character matches the expected
@@ -73,6 +139,12 @@ private:
         }
     }
 
+    /**
+     * Scans ahead until at least one token has been produced, or the end of
+     * the source is reached.
+     */
+    void scanStep();
+
     /**
      * Scans the next token in the source string.
      */
@@ -101,52 +173,68 @@ private:
     void scanComment();
 
     /**
-     * Scans in the tokens in a raw environment.
+     * Enters a raw environment, scanning in its start marker.
      *
      * @param start the start marker of the raw environment
      * @param end the end marker of the raw environment
      *
      * @note nested start/end pairs are permitted within the raw environment
      */
-    void scanRawEnvironment(char start, char end);
+    void enterRawEnvironment(char start, char end);
 
     /**
-     * Adds a token to the token stream.
-     *
-     * @param type the type of the token to push in
+     * Scans raw text in the innermost raw environment, up to either the next
+     * nested punch expression or the end of the environment.
      */
-    void addToken(TokenType type) { tokens.push_back(Token(type, line, col)); }
+    void scanRawChunk();
 
     /**
-     * Adds a string-literal token to the token stream.
+     * Adds a token spanning the current token's text to the token stream.
      *
      * @param type the type of the token to push in
-     * @stringLiteral the string literal attached to the token
      */
-    void addToken(TokenType type, std::string stringLiteral) {
-        tokens.push_back(Token(type, stringLiteral, line, col));
-    }
+    void addToken(TokenType type) { addToken(type, currTokenStart, idx); }
 
     /**
-     * Adds a number-literal token to the token stream.
+     * Adds a token spanning the given source range to the token stream.
      *
      * @param type the type of the token to push in
-     * @numberLiteral the number literal attached to the token
+     * @param start the offset of the first character of the token
+     * @param end the offset one past the last character of the token
      */
-    void addToken(TokenType type, int numberLiteral) {
-        tokens.push_back(Token(type, numberLiteral, line, col));
+    void addToken(TokenType type, size_t start, size_t end) {
+        // raw bash longer than a single token can describe is split into
+        // several adjacent raw expressions
+        while (type == TokenType::RAWEXPR && end - start > MAX_TOKEN_LENGTH) {
+            pending.push_back(Token(type, start, MAX_TOKEN_LENGTH));
+            start += MAX_TOKEN_LENGTH;
+        }
+        if (end - start > MAX_TOKEN_LENGTH) {
+            generateError("token is too long", start);
+        }
+        pending.push_back(Token(type, start, end - start));
     }
 
     /**
      * Generates an error when an unexpected character appears.
      *
      * @param seen the unexpected character to report
-     * @param line the line the character appeared on
-     * @param col the column of the character within the line
+     * @param offset the offset of the character in the source
+     */
+    [[noreturn]] void generateError(char seen, size_t offset) {
+        SourceLocation loc = getLocation(offset);
+        throw ScannerException(seen, loc.line, loc.col);
+    }
+
+    /**
+     * Generates an error for a malformed token.
+     *
+     * @param msg a description of the problem
+     * @param offset the offset in the source where the token started
      */
-    void generateError(char seen, size_t line, size_t col) {
-        PunchException::handleException(ScannerException(seen, line, col));
-        // TODO: non-breaking error handling
-        exit(1);
+    [[noreturn]] void generateError(const std::string& msg, size_t offset) {
+        SourceLocation loc = getLocation(offset);
+        throw ScannerException(msg + " on line " + std::to_string(loc.line) +
+                               ", column " + std::to_string(loc.col));
     }
 };
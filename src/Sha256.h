@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Incremental SHA-256 hash, as specified in FIPS 180-4.
+ */
+class Sha256 {
+public:
+    Sha256();
+
+    /**
+     * Feeds more bytes into the hash.
+     */
+    void update(std::string_view data);
+
+    /**
+     * Finishes the hash; no more data may be added afterwards.
+     *
+     * @return the digest as 64 lowercase hexadecimal digits
+     */
+    std::string hexDigest();
+
+private:
+    std::array<uint32_t, 8> state;
+    std::array<uint8_t, 64> block;
+    size_t blockSize;
+    uint64_t totalBytes;
+
+    void processBlock(const uint8_t* data);
+};
@@ -0,0 +1,90 @@
+#include "SourceBuffer.h"
+#include "PunchException.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::open(const std::string& filename,
+                                                 bool map) {
+    if (filename == "-") {
+        return fromDescriptor(STDIN_FILENO, "<stdin>", map);
+    }
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        generateError(filename, strerror(errno));
+    }
+    std::unique_ptr<SourceBuffer> result;
+    try {
+        result = fromDescriptor(fd, filename, map);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return result;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromDescriptor(
+    int fd, const std::string& name, bool map) {
+    auto buffer = std::unique_ptr<SourceBuffer>(new SourceBuffer(name));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        generateError(name, strerror(errno));
+    }
+
+    // map regular files straight into memory; the mapping outlives the fd
+    if (map && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mem = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mem != MAP_FAILED) {
+            madvise(mem, info.st_size, MADV_SEQUENTIAL);
+            buffer->data = static_cast<const char*>(mem);
+            buffer->size = info.st_size;
+            buffer->mapped = true;
+            return buffer;
+        }
+    }
+
+    // otherwise, stream the input in chunks until EOF
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+    std::string& storage = buffer->storage;
+    size_t used = 0;
+    while (true) {
+        if (storage.size() - used < CHUNK_SIZE) {
+            storage.resize(used + CHUNK_SIZE);
+        }
+        ssize_t count = read(fd, &storage[used], storage.size() - used);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            generateError(name, strerror(errno));
+        }
+        if (count == 0) {
+            break;
+        }
+        used += count;
+    }
+    storage.resize(used);
+
+    buffer->data = storage.data();
+    buffer->size = storage.size();
+    return buffer;
+}
+
+void SourceBuffer::generateError(const std::string& name,
+                                 const std::string& reason) {
+    throw IOException("cannot read '" + name + "': " + reason);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Read-only view of the source text of a single compilation.
+ *
+ * Regular files are memory-mapped and scanned in place. Anything else
+ * (pipes, terminals) is streamed into an owned buffer instead.
+ */
+class SourceBuffer {
+public:
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    /**
+     * Opens a source file by name.
+     *
+     * @param filename the path to the file, or "-" for stdin
+     * @param map whether a regular file may be mapped; a mapped file that is
+     * truncated while in use raises SIGBUS, so long-running processes read
+     * it into an owned buffer instead
+     * @return the loaded source buffer
+     */
+    static std::unique_ptr<SourceBuffer> open(const std::string& filename,
+                                              bool map = true);
+
+    /**
+     * Loads the source from an already-open file descriptor.
+     *
+     * @param fd the descriptor to read from; it is not closed
+     * @param name the name to report in diagnostics
+     * @param map whether a regular file may be mapped
+     * @return the loaded source buffer
+     */
+    static std::unique_ptr<SourceBuffer>
+    fromDescriptor(int fd, const std::string& name, bool map = true);
+
+    /**
+     * Gets the full source text.
+     *
+     * @return a view of the text, valid for the lifetime of the buffer
+     */
+    std::string_view getText() const { return std::string_view(data, size); }
+
+    /**
+     * Gets the name the source was loaded from.
+     */
+    const std::string& getName() const { return name; }
+
+    /**
+     * Checks whether the source is backed by a memory mapping.
+     */
+    bool isMapped() const { return mapped; }
+
+private:
+    SourceBuffer(std::string name) : name(name) {}
+
+    std::string name;
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string storage;
+
+    /**
+     * Generates an error when the source cannot be read.
+     *
+     * @param name the name of the source
+     * @param reason a description of the failure
+     */
+    [[noreturn]] static void generateError(const std::string& name,
+                                           const std::string& reason);
+};
@@ -0,0 +1,113 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : queuedCount(0), pendingCount(0), nextQueue(0), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this, i]() { run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        target = nextQueue++ % queues.size();
+        pendingCount++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        queuedCount++;
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this]() { return pendingCount == 0; });
+}
+
+void ThreadPool::run(size_t self) {
+    while (true) {
+        // claim one of the queued tasks before going looking for it
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            workAvailable.wait(
+                lock, [this]() { return stopping || queuedCount > 0; });
+            if (queuedCount == 0) {
+                return;
+            }
+            queuedCount--;
+        }
+
+        // the claim guarantees a task is available somewhere, but another
+        // worker may beat us to the one we see first
+        std::function<void()> task;
+        while (!task) {
+            task = take(self);
+        }
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            pendingCount--;
+            if (pendingCount == 0) {
+                allDone.notify_all();
+            }
+        }
+    }
+}
+
+std::function<void()> ThreadPool::take(size_t self) {
+    std::function<void()> task;
+
+    // newest task from our own queue first, while it is still cache-warm
+    {
+        WorkQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return task;
+        }
+    }
+
+    // otherwise steal the oldest task from the next busy worker
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return task;
+        }
+    }
+
+    return task;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed-size pool of worker threads with per-worker task queues.
+ *
+ * Submitted tasks are spread round-robin over the worker queues. A worker
+ * takes the most recently queued task from its own queue, and once that runs
+ * dry it steals the oldest task from another worker's queue.
+ */
+class ThreadPool {
+public:
+    /**
+     * Starts the worker threads.
+     *
+     * @param threadCount the number of workers; 0 means one per core
+     */
+    ThreadPool(size_t threadCount = 0);
+
+    /**
+     * Waits for all submitted tasks, then stops the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queues a task for execution on some worker.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Blocks until every submitted task has finished running.
+     */
+    void wait();
+
+    /**
+     * Gets the number of worker threads.
+     */
+    size_t getThreadCount() const { return workers.size(); }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    // tasks sitting in a queue that no worker has claimed yet
+    size_t queuedCount;
+
+    // tasks submitted but not yet finished
+    size_t pendingCount;
+
+    size_t nextQueue;
+    bool stopping;
+
+    /**
+     * Main loop of a worker thread.
+     *
+     * @param self the index of the worker's own queue
+     */
+    void run(size_t self);
+
+    /**
+     * Takes a task, preferring the worker's own queue.
+     *
+     * @param self the index of the worker's own queue
+     * @return the task, or an empty function if every queue was empty
+     */
+    std::function<void()> take(size_t self);
+};
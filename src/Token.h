@@ -1,11 +1,12 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <optional>
 #include <string>
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     // separators
     LPAREN,
     RPAREN,
@@ -15,6 +16,7 @@ enum class TokenType {
     RBRACKET,
     SEMICOLON,
     COMMA,
+    AT,
 
     // keywords
     FUNC,
@@ -27,6 +29,7 @@ enum class TokenType {
     VAR,
     EQUAL,
     RETURN,
+    IMPORT,
 
     // operators
     LOR,
@@ -70,6 +73,7 @@ inline std::string getSymbolForTokenType(TokenType type) {
         case TokenType::RBRACKET: return "]";
         case TokenType::SEMICOLON: return ";";
         case TokenType::COMMA: return ",";
+        case TokenType::AT: return "@";
 
         // keywords
         case TokenType::FUNC: return "FUNC";
@@ -82,6 +86,7 @@ inline std::string getSymbolForTokenType(TokenType type) {
         case TokenType::VAR: return "VAR";
         case TokenType::EQUAL: return "=";
         case TokenType::RETURN: return "RETURN";
+        case TokenType::IMPORT: return "IMPORT";
 
         // operators
         case TokenType::LOR: return "||";
@@ -120,52 +125,26 @@ inline std::string getSymbolForTokenType(TokenType type) {
     assert(false && "unsupported token type");
 }
 
+/**
+ * A single scanned token.
+ *
+ * Tokens do not own their text; they record the span of the source buffer
+ * they were scanned from, which the scanner keeps alive. For string and raw
+ * tokens the span excludes any surrounding delimiters.
+ */
 class Token {
 public:
-    const TokenType type;
-    size_t line;
-    size_t col;
+    TokenType type;
+    uint32_t length;
+    size_t offset;
 
-    Token(TokenType type, size_t line, size_t col)
-        : type(type), line(line), col(col), numberLiteral({}),
-          stringLiteral({}) {}
+    Token() : type(TokenType::END), length(0), offset(0) {}
 
-    Token(TokenType type, int numberLiteral, size_t line, size_t col)
-        : type(type), line(line), col(col), numberLiteral(numberLiteral),
-          stringLiteral({}) {}
-
-    Token(TokenType type, std::string stringLiteral, size_t line, size_t col)
-        : type(type), line(line), col(col), numberLiteral({}),
-          stringLiteral(stringLiteral) {}
-
-    bool isLiteral() const { return isNumberLiteral() || isStringLiteral(); }
-
-    bool isNumberLiteral() const { return numberLiteral.has_value(); }
-
-    bool isStringLiteral() const { return stringLiteral.has_value(); }
-
-    int getNumberLiteral() const {
-        assert(isNumberLiteral() && "token does not contain number literal");
-        return numberLiteral.value();
-    }
-
-    std::string getStringLiteral() const {
-        assert(isStringLiteral() && "token does not contain string literal");
-        return stringLiteral.value();
-    }
+    Token(TokenType type, size_t offset, uint32_t length)
+        : type(type), length(length), offset(offset) {}
 
     friend std::ostream& operator<<(std::ostream& os, const Token& token) {
         os << getSymbolForTokenType(token.type);
-        if (token.isStringLiteral()) {
-            os << "(" << token.getStringLiteral() << ")";
-        }
-        if (token.isNumberLiteral()) {
-            os << "(" << token.getNumberLiteral() << ")";
-        }
         return os;
     }
-
-private:
-    const std::optional<int> numberLiteral;
-    const std::optional<std::string> stringLiteral;
 };
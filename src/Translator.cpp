@@ -1,22 +1,280 @@
 #include "Translator.h"
+#include "AstUtils.h"
+#include "ObjectModule.h"
+
+#include <cctype>
+#include <set>
+
+namespace {
+
+/**
+ * Collects the names of the functions whose results are read somewhere,
+ * either as a value or through raw code that may inspect $__return.
+ */
+class ResultUseCollector : public AstNodeMapper {
+public:
+    ResultUseCollector(const std::unordered_set<const AstNode*>& discarded,
+                       const std::unordered_set<std::string_view>& functions,
+                       std::unordered_set<std::string_view>& used)
+        : discarded(discarded), functions(functions), used(used) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* call = dyn_cast<AstFunctionCall>(node)) {
+            if (discarded.count(call) == 0) {
+                used.insert(call->getName());
+            }
+        } else if (const auto* raw = dyn_cast<AstRawBashExpression>(node)) {
+            for (auto word : AstUtils::findWords(raw->getExpression())) {
+                if (functions.count(word) != 0) {
+                    used.insert(word);
+                }
+            }
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    const std::unordered_set<const AstNode*>& discarded;
+    const std::unordered_set<std::string_view>& functions;
+    std::unordered_set<std::string_view>& used;
+};
+
+/**
+ * Collects the calls a function makes to itself in return position, whose
+ * results are only read if the function's own result is.
+ */
+class SelfReturnCallCollector : public AstNodeMapper {
+public:
+    SelfReturnCallCollector(const AstFunctionDecl* function,
+                            std::unordered_set<const AstNode*>& calls)
+        : function(function), calls(calls) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* ret = dyn_cast<AstReturn>(node)) {
+            const auto* call = dyn_cast<AstFunctionCall>(ret->getExpression());
+            if (call != nullptr && call->getName() == function->getName()) {
+                calls.insert(call);
+            }
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    const AstFunctionDecl* function;
+    std::unordered_set<const AstNode*>& calls;
+};
+
+/**
+ * Checks whether a function returns the result of calling itself with a full
+ * set of arguments.
+ */
+class SelfTailCallFinder : public AstNodeMapper {
+public:
+    SelfTailCallFinder(const AstFunctionDecl* function, bool& found)
+        : function(function), found(found) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* ret = dyn_cast<AstReturn>(node)) {
+            const auto* call = dyn_cast<AstFunctionCall>(ret->getExpression());
+            found = found || (call != nullptr &&
+                              call->getName() == function->getName() &&
+                              call->getArguments().size() ==
+                                  function->getArguments().size());
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    const AstFunctionDecl* function;
+    bool& found;
+};
+
+/**
+ * Checks whether raw code may read the positional parameters, which stay
+ * fixed when a tail call is turned into a jump.
+ */
+class PositionalUseFinder : public AstNodeMapper {
+public:
+    PositionalUseFinder(bool& found) : found(found) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* raw = dyn_cast<AstRawBashExpression>(node)) {
+            std::string_view text = raw->getExpression();
+            for (size_t i = 0; i + 1 < text.size(); i++) {
+                size_t next = text[i + 1] == '{' ? i + 2 : i + 1;
+                if (text[i] == '$' && next < text.size() &&
+                    (std::isdigit(static_cast<unsigned char>(text[next])) ||
+                     text[next] == '@' || text[next] == '*' ||
+                     text[next] == '#')) {
+                    found = true;
+                }
+            }
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    bool& found;
+};
+
+/**
+ * Collects every name that code may refer to another function by: the names
+ * of called functions, and the words of raw code.
+ */
+class SymbolCollector : public AstNodeMapper {
+public:
+    SymbolCollector(std::set<std::string_view>& symbols) : symbols(symbols) {}
+
+    AstNode* mapNode(AstNode* node) const override {
+        if (const auto* call = dyn_cast<AstFunctionCall>(node)) {
+            symbols.insert(call->getName());
+        } else if (const auto* raw = dyn_cast<AstRawBashExpression>(node)) {
+            for (auto word : AstUtils::findWords(raw->getExpression())) {
+                symbols.insert(word);
+            }
+        }
+        node->apply(*this);
+        return node;
+    }
+
+private:
+    std::set<std::string_view>& symbols;
+};
+
+/**
+ * Checks whether evaluating an expression may read a variable.
+ */
+bool mayRead(const AstExpression* expr, std::string_view name) {
+    switch (expr->getKind()) {
+    case AstKind::Variable: return cast<AstVariable>(expr)->getName() == name;
+    case AstKind::NumberLiteral:
+    case AstKind::StringLiteral: return false;
+    case AstKind::BinaryExpression: {
+        const auto* binary = cast<AstBinaryExpression>(expr);
+        return mayRead(binary->getLHS(), name) ||
+               mayRead(binary->getRHS(), name);
+    }
+    // calls see the caller's locals, and raw code may read anything
+    default: return true;
+    }
+}
+
+} // namespace
+
+void Translator::run() {
+    analyse();
+    visit(program);
+}
+
+void Translator::runModule(ObjectModule& module) {
+    analyse();
+
+    // any function may be called from another module, which may read its
+    // result
+    for (const auto* function : program->getFunctions()) {
+        usedResults.insert(function->getName());
+    }
+
+    for (auto path : program->getImports()) {
+        module.imports.emplace_back(path);
+    }
+
+    // translate each part into a stream of its own, restoring the emitter
+    // afterwards
+    std::stringstream globals;
+    std::ostream& previous = out.redirect(globals);
+    emitCaches(program);
+    emitGlobals(program);
+    out.flush();
+    module.globals = globals.str();
+
+    std::set<std::string_view> globalSymbols;
+    for (auto* assignment : program->getAssignments()) {
+        assignment->apply(SymbolCollector(globalSymbols));
+    }
+    module.globalReferences.assign(globalSymbols.begin(), globalSymbols.end());
+
+    for (auto* function : program->getFunctions()) {
+        std::stringstream code;
+        out.redirect(code);
+        visit(function);
+        out.flush();
+
+        std::set<std::string_view> symbols;
+        function->apply(SymbolCollector(symbols));
+
+        ObjectModule::Function result;
+        result.name = function->getName();
+        result.bashName = getBashIdentifier(function->getName());
+        result.references.assign(symbols.begin(), symbols.end());
+        result.code = code.str();
+        module.functions.push_back(std::move(result));
+    }
+
+    out.redirect(previous);
+}
+
+void Translator::analyse() {
+    std::unordered_set<std::string_view> functions;
+    for (const auto* function : program->getFunctions()) {
+        functions.insert(function->getName());
+    }
+
+    // a function returning its own call's result does not read it itself
+    auto discarded = AstUtils::findStatementCalls(program);
+    for (auto* function : program->getFunctions()) {
+        function->apply(SelfReturnCallCollector(function, discarded));
+    }
+
+    usedResults.clear();
+    ResultUseCollector collector(discarded, functions, usedResults);
+    collector.mapNode(program);
+
+    // a redefined function may not be the one its own calls reach
+    std::unordered_set<std::string_view> redefined;
+    std::unordered_set<std::string_view> seen;
+    for (const auto* function : program->getFunctions()) {
+        if (!seen.insert(function->getName()).second) {
+            redefined.insert(function->getName());
+        }
+    }
+
+    tailRecursive.clear();
+    for (auto* function : program->getFunctions()) {
+        bool selfCall = false;
+        bool positional = false;
+        function->apply(SelfTailCallFinder(function, selfCall));
+        function->apply(PositionalUseFinder(positional));
+        if (selfCall && !positional &&
+            redefined.count(function->getName()) == 0) {
+            tailRecursive.insert(function);
+        }
+    }
+}
 
 void Translator::visitProgram(const AstProgram* program) {
-    os << "#!/bin/bash";
+    out << "#!/bin/bash";
     newLine();
     newLine();
 
+    bool caches = emitCaches(program);
+    if (caches) {
+        newLine();
+    }
+
     if (!program->getAssignments().empty()) {
-        os << "# global variables";
+        out << "# global variables";
         newLine();
-        for (const auto* assignment : program->getAssignments()) {
-            visitAssignment(assignment);
-            newLine();
-        }
+        emitGlobals(program);
         newLine();
     }
 
     if (!program->getFunctions().empty()) {
-        os << "# functions";
+        out << "# functions";
         newLine();
         for (const auto* function : program->getFunctions()) {
             visit(function);
@@ -25,134 +283,362 @@ void Translator::visitProgram(const AstProgram* program) {
         }
     }
 
-    os << "# start the program";
+    out << "# start the program";
     newLine();
 
-    os << getBashIdentifier("main");
+    out << getBashIdentifier("main");
     newLine();
 }
 
+bool Translator::emitCaches(const AstProgram* program) {
+    bool caches = false;
+    for (const auto* function : program->getFunctions()) {
+        if (isMemoized(function)) {
+            if (!caches) {
+                out << "# memoization caches";
+                newLine();
+                caches = true;
+            }
+            out << "declare -A " << getMemoCache(function->getName());
+            newLine();
+        }
+    }
+    return caches;
+}
+
+void Translator::emitGlobals(const AstProgram* program) {
+    for (const auto* assignment : program->getAssignments()) {
+        visitAssignment(assignment);
+        newLine();
+    }
+}
+
 void Translator::visitFunctionDecl(const AstFunctionDecl* function) {
     std::string bID = getBashIdentifier(function->getName());
-    os << bID << " () {";
+    out << bID << " () {";
 
+    // temporaries are local, so each function can reuse the same names
+    currentFunction = function->getName();
+    variableCount = 0;
+    loopDepth = 0;
+    inFunction = true;
     tabInc();
 
     size_t argCount = 0;
     for (const auto* arg : function->getArguments()) {
         newLine();
         std::string argID = getBashIdentifier(arg->getName());
-        os << "local " << argID << "=\"$" << ++argCount << "\"";
+        out << "local " << argID << "=\"$" << ++argCount << "\"";
+    }
+
+    memoizing = isMemoized(function);
+    if (memoizing) {
+        emitMemoLookup(function);
+    }
+
+    // self tail calls jump back to the top of the body instead of nesting
+    const auto& stmts = function->getStatements();
+    bool tailLoop = tailRecursive.count(function) != 0;
+    if (tailLoop) {
+        tailFunction = function;
+        newLine();
+        out << "while :";
+        newLine();
+        out << "do";
+        tabInc();
     }
 
-    for (const auto* stmt : function->getStatements()) {
+    for (const auto* stmt : stmts) {
         newLine();
         visit(stmt);
     }
 
+    if (tailLoop) {
+        if (!isa<AstReturn>(stmts[stmts.size() - 1])) {
+            newLine();
+            out << "break";
+        }
+        tabDec();
+        newLine();
+        out << "done";
+        tailFunction = nullptr;
+    }
+    memoizing = false;
+
+    // bash rejects a function without any commands
+    if (function->getArguments().empty() &&
+        function->getStatements().empty()) {
+        newLine();
+        out << ":";
+    }
+
     tabDec();
+    inFunction = false;
     newLine();
-    os << "}";
+    out << "}";
 }
 
 void Translator::visitFunctionCall(const AstFunctionCall* call) {
     std::string functionID = getBashIdentifier(call->getName());
+    const auto& args = call->getArguments();
 
-    std::vector<std::string> arguments;
-    for (const auto* arg : call->getArguments()) {
-        std::string argVar = generateVariable();
-        arguments.push_back(argVar);
+    // arguments are only expanded once every call among them has run, so
+    // any argument before the last such call is captured as it is reached
+    size_t lastCall = 0;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (hasCalls(args[i])) {
+            lastCall = i + 1;
+        }
+    }
 
-        if (dynamic_cast<const AstFunctionCall*>(arg) != nullptr) {
+    std::vector<std::string> temporaries(args.size());
+    for (size_t i = 0; i < lastCall; i++) {
+        const auto* arg = args[i];
+        bool last = i + 1 == lastCall;
+        if (isa<AstFunctionCall>(arg)) {
             visit(arg);
             newLine();
-            os << argVar << "=\"$__return\"";
-        } else {
-            os << argVar << "=";
-            visit(arg);
+            if (last) {
+                temporaries[i] = "__return";
+            } else {
+                temporaries[i] = declareTemporary();
+                out << "\"$__return\"";
+                newLine();
+            }
+        } else if (last) {
+            hoistCalls(arg);
+        } else if (!isa<AstLiteral>(arg)) {
+            hoistCalls(arg);
+            temporaries[i] = declareTemporary();
+            visitValue(arg);
+            newLine();
         }
-        newLine();
     }
 
-    os << functionID;
-    for (const auto& arg : arguments) {
-        os << " \"$" << arg << "\"";
+    out << functionID;
+    for (size_t i = 0; i < args.size(); i++) {
+        out << " ";
+        if (temporaries[i].empty()) {
+            visitValue(args[i]);
+        } else {
+            out << "\"$" << temporaries[i] << "\"";
+        }
     }
 }
 
 void Translator::visitAssignment(const AstAssignment* assignment) {
-    std::string pID = assignment->getVariable()->getName();
+    std::string_view pID = assignment->getVariable()->getName();
     std::string bID = getBashIdentifier(pID);
 
-    const auto* expr = assignment->getExpression();
-    if (dynamic_cast<const AstFunctionCall*>(expr) != nullptr) {
+    emitAssignment(bID, assignment->getExpression(),
+                   assignment->isDeclaration());
+}
+
+void Translator::emitMemoLookup(const AstFunctionDecl* function) {
+    // the key joins the arguments with a separator, after a prefix that
+    // keeps it non-empty
+    newLine();
+    out << "local _memo_key=\"@";
+    bool first = true;
+    for (const auto* arg : function->getArguments()) {
+        out << (first ? "" : "\"$'\\x1f'\"");
+        out << "$" << getBashIdentifier(arg->getName());
+        first = false;
+    }
+    out << "\"";
+
+    std::string cache = getMemoCache(function->getName());
+    newLine();
+    out << "if [[ -n \"${" << cache << "[$_memo_key]+set}\" ]]";
+    newLine();
+    out << "then";
+    tabInc();
+    newLine();
+    out << "__return=\"${" << cache << "[$_memo_key]}\"";
+    newLine();
+    out << "return 0";
+    tabDec();
+    newLine();
+    out << "fi";
+}
+
+void Translator::emitAssignment(const std::string& bID,
+                                const AstExpression* expr, bool declaration) {
+    // only declarations inside a function introduce a new local
+    const char* prefix = declaration && inFunction ? "local " : "";
+
+    if (isa<AstFunctionCall>(expr)) {
         visit(expr);
         newLine();
-        os << "local " << bID << "=\"$__return\"";
+        out << prefix << bID << "=\"$__return\"";
+        return;
+    }
+
+    hoistCalls(expr);
+    if (!declaration && isa<AstBinaryExpression>(expr)) {
+        // update the variable from within the arithmetic context itself;
+        // (( )) fails on a zero value, which must not end a function's
+        // status or a script under set -e
+        out << "(( " << bID << " = ";
+        emitArithmetic(expr);
+        out << " )) || :";
     } else {
-        os << "local " << bID << "=";
-        visit(assignment->getExpression());
+        out << prefix << bID << "=";
+        visitValue(expr);
     }
 }
 
 void Translator::visitVariable(const AstVariable* variable) {
     std::string bID = getBashIdentifier(variable->getName());
-    os << "\"$" << bID << "\"";
+    out << "\"$" << bID << "\"";
 }
 
 void Translator::visitNumberLiteral(const AstNumberLiteral* lit) {
-    os << lit->getNumber();
+    out << lit->getNumber();
 }
 
 void Translator::visitStringLiteral(const AstStringLiteral* lit) {
-    os << "\"" << lit->getString() << "\"";
+    out << "\"" << lit->getString() << "\"";
 }
 
 void Translator::visitBinaryExpression(const AstBinaryExpression* expr) {
-    os << "$((";
-    visit(expr->getLHS());
-    os << expr->getOperator();
-    visit(expr->getRHS());
-    os << "))";
+    out << "$((";
+    emitArithmetic(expr);
+    out << "))";
 }
 
 void Translator::visitReturn(const AstReturn* ret) {
     const auto* expr = ret->getExpression();
-    if (dynamic_cast<const AstFunctionCall*>(expr) != nullptr) {
+    bool discarded = usedResults.count(currentFunction) == 0;
+    const auto* call = dyn_cast<AstFunctionCall>(expr);
+    if (tailFunction != nullptr && call != nullptr &&
+        call->getName() == tailFunction->getName() &&
+        call->getArguments().size() == tailFunction->getArguments().size()) {
+        emitTailCall(call);
+        // jump past any loops in the body to the one around it
+        out << "continue";
+        if (loopDepth != 0) {
+            out << " " << loopDepth + 1;
+        }
+        return;
+    }
+    if (isa<AstFunctionCall>(expr)) {
         visit(expr);
-    } else {
-        os << "__return=";
-        visit(ret->getExpression());
+        newLine();
+    } else if (!discarded || !AstUtils::isSideEffectFree(expr)) {
+        hoistCalls(expr);
+        out << "__return=";
+        visitValue(expr);
+        newLine();
     }
-    newLine();
-    os << "return 0";
+
+    if (memoizing) {
+        std::string cache = getMemoCache(currentFunction);
+        if (memoLimit != 0) {
+            out << "(( ${#" << cache << "[@]} < " << memoLimit << " )) || "
+                << cache << "=()";
+            newLine();
+        }
+        out << cache << "[$_memo_key]=\"$__return\"";
+        newLine();
+    }
+    out << "return 0";
 }
 
 void Translator::visitRawBashExpression(const AstRawBashExpression* raw) {
-    os << raw->getExpression();
+    out << raw->getExpression();
 }
 
 void Translator::visitRawPunchExpression(const AstRawPunchExpression* expr) {
-    visit(expr->getExpression());
+    emitWord(expr->getExpression());
 }
 
 void Translator::visitRawEnvironment(const AstRawEnvironment* env) {
-    for (auto* expr : env->getExpressions()) {
-        visit(expr);
+    // split the code into logical lines, so each line's calls can be made
+    // just ahead of that line
+    std::vector<RawPiece> line;
+    bool first = true;
+    for (const auto* expr : env->getExpressions()) {
+        if (const auto* punch = dyn_cast<AstRawPunchExpression>(expr)) {
+            line.push_back({{}, punch->getExpression()});
+            continue;
+        }
+
+        const auto* raw = cast<AstRawBashExpression>(expr);
+        std::string_view text = raw->getExpression();
+        size_t pos = text.find('\n');
+        while (pos != std::string_view::npos) {
+            // a backslash-newline continues the same command
+            if (isContinued(text.substr(0, pos))) {
+                pos = text.find('\n', pos + 1);
+                continue;
+            }
+            line.push_back({text.substr(0, pos), nullptr});
+            emitRawLine(line, first);
+            line.clear();
+            first = false;
+            text.remove_prefix(pos + 1);
+            pos = text.find('\n');
+        }
+        if (!text.empty()) {
+            line.push_back({text, nullptr});
+        }
+    }
+    emitRawLine(line, first);
+}
+
+bool Translator::isContinued(std::string_view text) {
+    size_t backslashes = 0;
+    while (backslashes < text.size() &&
+           text[text.size() - backslashes - 1] == '\\') {
+        backslashes++;
     }
+    return backslashes % 2 == 1;
 }
 
-void Translator::visitTrue(const AstTrue* val) { os << "true"; }
+void Translator::emitRawLine(const std::vector<RawPiece>& line,
+                             bool first) {
+    if (!first) {
+        bool calls = false;
+        for (const auto& piece : line) {
+            calls = calls || (piece.expr != nullptr && hasCalls(piece.expr));
+        }
+        // calls made ahead of the line are indented like any statement;
+        // otherwise the raw code keeps its own layout
+        if (calls) {
+            newLine();
+        } else {
+            out << '\n';
+        }
+    }
+    for (const auto& piece : line) {
+        if (piece.expr != nullptr) {
+            hoistInterpolation(piece.expr);
+        }
+    }
+    for (const auto& piece : line) {
+        if (piece.expr != nullptr) {
+            emitWord(piece.expr);
+        } else {
+            out << piece.text;
+        }
+    }
+}
 
-void Translator::visitFalse(const AstFalse* val) { os << "false"; }
+void Translator::hoistInterpolation(const AstExpression* expr) {
+    // only calls must run ahead of the line; anything else expands in
+    // place, so it sees what earlier commands on the line assign
+    if (hasCalls(expr)) {
+        hoistCalls(expr);
+    }
+}
 
 void Translator::visitSimpleConditional(
     const AstSimpleConditional* conditional) {
-    os << "if $(";
-    visit(conditional->getCondition());
-    os << ")";
+    out << "if ";
+    emitCondition(conditional->getCondition());
     newLine();
-    os << "then";
+    out << "then";
 
     tabInc();
     newLine();
@@ -160,26 +646,15 @@ void Translator::visitSimpleConditional(
     tabDec();
 
     newLine();
-    os << "fi";
+    out << "fi";
 }
 
 void Translator::visitBranchingConditional(
     const AstBranchingConditional* conditional) {
-    os << "if ";
-
-    const auto* cond = conditional->getCondition();
-    if (dynamic_cast<const AstBinaryComparison*>(cond) != nullptr) {
-        os << "(( ";
-        visit(cond);
-        os << " ))";
-    } else {
-        os << "$( ";
-        visit(cond);
-        os << " )";
-    }
-
+    out << "if ";
+    emitCondition(conditional->getCondition());
     newLine();
-    os << "then";
+    out << "then";
 
     tabInc();
     newLine();
@@ -188,39 +663,467 @@ void Translator::visitBranchingConditional(
 
     newLine();
     const auto* elseBranch = conditional->getElseBranch();
-    if (dynamic_cast<const AstConditional*>(elseBranch) != nullptr) {
-        os << "el";
+    if (isa<AstConditional>(elseBranch)) {
+        out << "el";
         visit(elseBranch);
     } else {
-        os << "else";
+        out << "else";
         tabInc();
         newLine();
         visit(elseBranch);
         tabDec();
         newLine();
-        os << "fi";
+        out << "fi";
+    }
+}
+
+void Translator::visitForLoop(const AstForLoop* loop) {
+    const auto* init = loop->getInit();
+    const auto* cond = loop->getCondition();
+    const auto* step = loop->getStep();
+
+    bool arithmeticInit = isArithmeticStatement(init);
+    if (!arithmeticInit) {
+        visit(init);
+        newLine();
+    }
+
+    // a counted loop runs entirely within the arithmetic for (( ))
+    if (isArithmeticCondition(cond) && isArithmeticStatement(step)) {
+        out << "for (( ";
+        if (arithmeticInit) {
+            emitArithmeticStatement(init);
+        }
+        out << "; ";
+        emitArithmeticCondition(cond);
+        out << "; ";
+        emitArithmeticStatement(step);
+        out << " ))";
+        emitLoopBody(loop->getBody(), nullptr);
+        return;
+    }
+
+    if (arithmeticInit) {
+        out << "(( ";
+        emitArithmeticStatement(init);
+        out << " )) || :";
+        newLine();
     }
+    out << "while ";
+    emitCondition(cond);
+    emitLoopBody(loop->getBody(), step);
+}
+
+void Translator::visitWhileLoop(const AstWhileLoop* loop) {
+    out << "while ";
+    emitCondition(loop->getCondition());
+    emitLoopBody(loop->getBody(), nullptr);
 }
 
 void Translator::visitStatementBlock(const AstStatementBlock* stmtBlock) {
-    os << "{";
+    out << "{";
 
     tabInc();
     for (const auto* stmt : stmtBlock->getStatements()) {
         newLine();
         visit(stmt);
     }
+    if (stmtBlock->getStatements().empty()) {
+        newLine();
+        out << ":";
+    }
     tabDec();
     newLine();
 
-    os << "}";
+    out << "}";
+}
+
+
+void Translator::visitValue(const AstExpression* expr) {
+    if (isa<AstRawEnvironment>(expr)) {
+        // the raw code produces the value through its output
+        out << "\"$(";
+        visit(expr);
+        out << ")\"";
+    } else {
+        visit(expr);
+    }
+}
+
+void Translator::emitArithmetic(const AstExpression* expr) {
+    switch (expr->getKind()) {
+    case AstKind::BinaryExpression: {
+        const auto* binary = cast<AstBinaryExpression>(expr);
+        int precedence = getPrecedence(binary->getOperator());
+
+        // operators are left-associative, so a right operand of equal
+        // precedence still needs parentheses
+        const auto* lhs = dyn_cast<AstBinaryExpression>(binary->getLHS());
+        bool lhsParens =
+            lhs != nullptr && getPrecedence(lhs->getOperator()) < precedence;
+        const auto* rhs = dyn_cast<AstBinaryExpression>(binary->getRHS());
+        bool rhsParens =
+            rhs != nullptr && getPrecedence(rhs->getOperator()) <= precedence;
+
+        out << (lhsParens ? "(" : "");
+        emitArithmetic(binary->getLHS());
+        out << (lhsParens ? ")" : "");
+        out << " " << getSymbolForBinaryOperator(binary->getOperator()) << " ";
+        out << (rhsParens ? "(" : "");
+        emitArithmetic(binary->getRHS());
+        out << (rhsParens ? ")" : "");
+        break;
+    }
+    case AstKind::Variable:
+        // bash looks up bare names itself inside an arithmetic context
+        out << getBashIdentifier(cast<AstVariable>(expr)->getName());
+        break;
+    case AstKind::NumberLiteral: {
+        // folding can produce negative literals, which would otherwise run
+        // into the operator before them
+        int64_t number = cast<AstNumberLiteral>(expr)->getNumber();
+        if (number < 0) {
+            out << "(" << number << ")";
+        } else {
+            out << number;
+        }
+        break;
+    }
+    case AstKind::FunctionCall: {
+        auto pos = callResults.find(expr);
+        assert(pos != callResults.end() && "call was not hoisted");
+        out << pos->second;
+        break;
+    }
+    case AstKind::RawEnvironment:
+        out << "$(";
+        visit(expr);
+        out << ")";
+        break;
+    default: visit(expr); break;
+    }
+}
+
+void Translator::hoistCalls(const AstExpression* expr) {
+    if (isa<AstFunctionCall>(expr)) {
+        if (callResults.count(expr) != 0) {
+            // already made ahead of the statement, such as a call in a raw
+            // environment used as a value
+            return;
+        }
+        visit(expr);
+        newLine();
+        std::string result = declareTemporary();
+        out << "\"$__return\"";
+        newLine();
+        callResults[expr] = result;
+    } else if (const auto* binary = dyn_cast<AstBinaryExpression>(expr)) {
+        // evaluate calls left to right, as they appear in the source
+        hoistCalls(binary->getLHS());
+        hoistCalls(binary->getRHS());
+    } else if (const auto* env = dyn_cast<AstRawEnvironment>(expr)) {
+        for (const auto* raw : env->getExpressions()) {
+            if (const auto* punch = dyn_cast<AstRawPunchExpression>(raw)) {
+                hoistInterpolation(punch->getExpression());
+            }
+        }
+    }
+}
+
+void Translator::emitArithmeticStatement(const AstStatement* stmt) {
+    if (const auto* assignment = dyn_cast<AstAssignment>(stmt)) {
+        out << getBashIdentifier(assignment->getVariable()->getName())
+            << " = ";
+        emitArithmetic(assignment->getExpression());
+    } else {
+        emitArithmetic(cast<AstExpression>(stmt));
+    }
+}
+
+void Translator::emitLoopBody(const AstStatementBlock* body,
+                              const AstStatement* step) {
+    newLine();
+    out << "do";
+
+    tabInc();
+    loopDepth++;
+    for (const auto* stmt : body->getStatements()) {
+        newLine();
+        visit(stmt);
+    }
+    if (step != nullptr && isArithmeticStatement(step)) {
+        newLine();
+        out << "(( ";
+        emitArithmeticStatement(step);
+        out << " )) || :";
+    } else if (step != nullptr) {
+        newLine();
+        visit(step);
+    } else if (body->getStatements().empty()) {
+        newLine();
+        out << ":";
+    }
+    loopDepth--;
+    tabDec();
+
+    newLine();
+    out << "done";
 }
 
-void Translator::visitBinaryComparison(const AstBinaryComparison* comp) {
-    // TODO: NOTE: assumes numbers at the moment
-    os << "(";
-    visit(comp->getLHS());
-    os << " " << comp->getOperator() << " ";
-    visit(comp->getRHS());
-    os << ")";
+void Translator::emitTailCall(const AstFunctionCall* call) {
+    const auto& params = tailFunction->getArguments();
+    const auto& args = call->getArguments();
+
+    // every argument must see the parameters as they were before the call,
+    // so a parameter read by a later argument is only updated at the end
+    std::vector<std::pair<std::string, std::string>> deferred;
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string_view name = params[i]->getName();
+        std::string bID = getBashIdentifier(name);
+
+        const auto* var = dyn_cast<AstVariable>(args[i]);
+        if (var != nullptr && var->getName() == name) {
+            continue;
+        }
+
+        bool readLater = false;
+        for (size_t j = i + 1; j < args.size(); j++) {
+            readLater = readLater || mayRead(args[j], name);
+        }
+        if (!readLater) {
+            emitAssignment(bID, args[i], false);
+            newLine();
+            continue;
+        }
+
+        if (isa<AstFunctionCall>(args[i])) {
+            visit(args[i]);
+            newLine();
+            deferred.emplace_back(bID, declareTemporary());
+            out << "\"$__return\"";
+        } else {
+            hoistCalls(args[i]);
+            deferred.emplace_back(bID, declareTemporary());
+            visitValue(args[i]);
+        }
+        newLine();
+    }
+
+    for (const auto& [bID, temporary] : deferred) {
+        out << bID << "=\"$" << temporary << "\"";
+        newLine();
+    }
+}
+
+void Translator::emitCondition(const AstCondition* cond) {
+    if (isArithmeticCondition(cond)) {
+        out << "(( ";
+        emitArithmeticCondition(cond);
+        out << " ))";
+    } else {
+        emitCommandCondition(cond);
+    }
+}
+
+void Translator::emitArithmeticCondition(const AstCondition* cond) {
+    switch (cond->getKind()) {
+    case AstKind::Conjunction:
+    case AstKind::Disjunction: {
+        bool conjunction = isa<AstConjunction>(cond);
+        const auto* lhs = conjunction ? cast<AstConjunction>(cond)->getLHS()
+                                      : cast<AstDisjunction>(cond)->getLHS();
+        const auto* rhs = conjunction ? cast<AstConjunction>(cond)->getRHS()
+                                      : cast<AstDisjunction>(cond)->getRHS();
+
+        // && binds more tightly than ||, and both are associative
+        for (const auto* operand : {lhs, rhs}) {
+            bool parens = conjunction && isa<AstDisjunction>(operand);
+            out << (parens ? "(" : "");
+            emitArithmeticCondition(operand);
+            out << (parens ? ")" : "");
+            if (operand == lhs) {
+                out << (conjunction ? " && " : " || ");
+            }
+        }
+        break;
+    }
+    case AstKind::Negation: {
+        const auto* operand = cast<AstNegation>(cond)->getCondition();
+        bool parens = !isa<AstTrue>(operand) && !isa<AstFalse>(operand) &&
+                      !isa<AstNegation>(operand);
+        out << "!" << (parens ? "(" : "");
+        emitArithmeticCondition(operand);
+        out << (parens ? ")" : "");
+        break;
+    }
+    case AstKind::BinaryComparison: {
+        const auto* comp = cast<AstBinaryComparison>(cond);
+        emitArithmetic(comp->getLHS());
+        out << " " << getSymbolForComparisonOperator(comp->getOperator())
+            << " ";
+        emitArithmetic(comp->getRHS());
+        break;
+    }
+    case AstKind::True: out << "1"; break;
+    case AstKind::False: out << "0"; break;
+    default: assert(false && "unexpected condition");
+    }
+}
+
+void Translator::emitCommandCondition(const AstCondition* cond) {
+    // any purely numeric part still needs only one test
+    if (isArithmeticCondition(cond)) {
+        out << "(( ";
+        emitArithmeticCondition(cond);
+        out << " ))";
+        return;
+    }
+
+    switch (cond->getKind()) {
+    case AstKind::Conjunction:
+    case AstKind::Disjunction: {
+        bool conjunction = isa<AstConjunction>(cond);
+        const auto* lhs = conjunction ? cast<AstConjunction>(cond)->getLHS()
+                                      : cast<AstDisjunction>(cond)->getLHS();
+        const auto* rhs = conjunction ? cast<AstConjunction>(cond)->getRHS()
+                                      : cast<AstDisjunction>(cond)->getRHS();
+
+        // the shell's && and || have equal precedence and group to the left,
+        // so only a compound right operand needs grouping
+        emitCommandCondition(lhs);
+        out << (conjunction ? " && " : " || ");
+        bool group = isa<AstConjunction>(rhs) || isa<AstDisjunction>(rhs);
+        out << (group ? "{ " : "");
+        emitCommandCondition(rhs);
+        out << (group ? "; }" : "");
+        break;
+    }
+    case AstKind::Negation: {
+        const auto* operand = cast<AstNegation>(cond)->getCondition();
+        bool group = !isa<AstBinaryComparison>(operand);
+        out << "! " << (group ? "{ " : "");
+        emitCommandCondition(operand);
+        out << (group ? "; }" : "");
+        break;
+    }
+    case AstKind::BinaryComparison:
+        emitComparisonCommand(cast<AstBinaryComparison>(cond));
+        break;
+    case AstKind::True: out << "true"; break;
+    case AstKind::False: out << "false"; break;
+    default: assert(false && "unexpected condition");
+    }
+}
+
+void Translator::emitComparisonCommand(const AstBinaryComparison* comp) {
+    // calls run inside a group, so short-circuiting still skips them
+    bool calls = hasCalls(comp->getLHS()) || hasCalls(comp->getRHS());
+    if (calls) {
+        out << "{";
+        tabInc();
+        newLine();
+        hoistCalls(comp->getLHS());
+        hoistCalls(comp->getRHS());
+    }
+
+    if (isStringComparison(comp)) {
+        // [[ ]] has no <= or >=, so test the negated strict comparison
+        const char* symbol = nullptr;
+        bool negate = false;
+        switch (comp->getOperator()) {
+        case ComparisonOperator::LT: symbol = "<"; break;
+        case ComparisonOperator::GT: symbol = ">"; break;
+        case ComparisonOperator::LE: symbol = ">", negate = true; break;
+        case ComparisonOperator::GE: symbol = "<", negate = true; break;
+        case ComparisonOperator::EQ: symbol = "=="; break;
+        case ComparisonOperator::NE: symbol = "!="; break;
+        }
+
+        out << "[[ " << (negate ? "! " : "");
+        emitWord(comp->getLHS());
+        out << " " << symbol << " ";
+        emitWord(comp->getRHS());
+        out << " ]]";
+    } else {
+        out << "(( ";
+        emitArithmeticCondition(comp);
+        out << " ))";
+    }
+
+    if (calls) {
+        tabDec();
+        newLine();
+        out << "}";
+    }
+}
+
+void Translator::emitWord(const AstExpression* expr) {
+    auto pos = callResults.find(expr);
+    if (pos != callResults.end()) {
+        out << "\"$" << pos->second << "\"";
+    } else {
+        visitValue(expr);
+    }
+}
+
+bool Translator::isArithmeticCondition(const AstCondition* cond) {
+    switch (cond->getKind()) {
+    case AstKind::Conjunction: {
+        const auto* conj = cast<AstConjunction>(cond);
+        return isArithmeticCondition(conj->getLHS()) &&
+               isArithmeticCondition(conj->getRHS());
+    }
+    case AstKind::Disjunction: {
+        const auto* disj = cast<AstDisjunction>(cond);
+        return isArithmeticCondition(disj->getLHS()) &&
+               isArithmeticCondition(disj->getRHS());
+    }
+    case AstKind::Negation:
+        return isArithmeticCondition(cast<AstNegation>(cond)->getCondition());
+    case AstKind::BinaryComparison: {
+        const auto* comp = cast<AstBinaryComparison>(cond);
+        return !isStringComparison(comp) && !hasCalls(comp->getLHS()) &&
+               !hasCalls(comp->getRHS());
+    }
+    default: return true;
+    }
+}
+
+bool Translator::isArithmeticStatement(const AstStatement* stmt) {
+    const AstExpression* expr = nullptr;
+    if (const auto* assignment = dyn_cast<AstAssignment>(stmt)) {
+        if (assignment->isDeclaration()) {
+            return false;
+        }
+        expr = assignment->getExpression();
+        if (isa<AstNumberLiteral>(expr)) {
+            return true;
+        }
+    } else {
+        expr = cast<AstExpression>(stmt);
+    }
+    return isa<AstBinaryExpression>(expr) && !hasCalls(expr);
+}
+
+bool Translator::isStringComparison(const AstBinaryComparison* comp) {
+    return isa<AstStringLiteral>(comp->getLHS()) ||
+           isa<AstStringLiteral>(comp->getRHS());
+}
+
+bool Translator::hasCalls(const AstExpression* expr) {
+    if (isa<AstFunctionCall>(expr)) {
+        return true;
+    }
+    if (const auto* binary = dyn_cast<AstBinaryExpression>(expr)) {
+        return hasCalls(binary->getLHS()) || hasCalls(binary->getRHS());
+    }
+    if (const auto* env = dyn_cast<AstRawEnvironment>(expr)) {
+        for (const auto* raw : env->getExpressions()) {
+            const auto* punch = dyn_cast<AstRawPunchExpression>(raw);
+            if (punch != nullptr && hasCalls(punch->getExpression())) {
+                return true;
+            }
+        }
+    }
+    return false;
 }
@@ -1,16 +1,38 @@
 #pragma once
 
 #include "AstVisitor.h"
+#include "CodeEmitter.h"
 
 #include <map>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ObjectModule;
 
 class Translator : public AstVisitor<void> {
 public:
-    Translator(std::ostream& os, AstProgram* program)
-        : os(os), program(program), identMap({}), tabLevel(0) {}
+    /**
+     * @param memoLimit the most results a memoized function caches before
+     * its cache is emptied, or 0 for no limit
+     */
+    Translator(CodeEmitter& out, AstProgram* program, size_t memoLimit = 0)
+        : out(out), program(program), identMap({}), tabLevel(0),
+          variableCount(0), loopDepth(0), inFunction(false),
+          tailFunction(nullptr), memoLimit(memoLimit), memoizing(false) {}
+
+    void run();
 
-    void run() { visit(program); }
+    /**
+     * Translates the program as a module to be linked with others, taking
+     * each part out of the emitter into an object module rather than
+     * emitting a complete script.
+     *
+     * Every function is kept and assumed to be called from elsewhere.
+     */
+    void runModule(ObjectModule& module);
 
 protected:
     void visitProgram(const AstProgram*) override;
@@ -25,32 +47,85 @@ protected:
     void visitRawBashExpression(const AstRawBashExpression*) override;
     void visitRawPunchExpression(const AstRawPunchExpression*) override;
     void visitRawEnvironment(const AstRawEnvironment*) override;
-    void visitTrue(const AstTrue*) override;
-    void visitFalse(const AstFalse*) override;
     void visitSimpleConditional(const AstSimpleConditional*) override;
     void visitBranchingConditional(const AstBranchingConditional*) override;
+    void visitForLoop(const AstForLoop*) override;
+    void visitWhileLoop(const AstWhileLoop*) override;
     void visitStatementBlock(const AstStatementBlock*) override;
-    void visitBinaryComparison(const AstBinaryComparison*) override;
 
 private:
-    std::ostream& os;
+    /**
+     * Works out the facts about the whole program that translation depends
+     * on: which results are read, and which functions are tail recursive.
+     */
+    void analyse();
+
+    /**
+     * Emits the declarations of the memoization caches, headed by a comment.
+     *
+     * @return whether there were any caches to declare
+     */
+    bool emitCaches(const AstProgram* program);
+
+    /**
+     * Emits the assignments to global variables.
+     */
+    void emitGlobals(const AstProgram* program);
+
+    CodeEmitter& out;
     AstProgram* program;
-    std::map<std::string, std::string> identMap;
+    std::map<std::string, std::string, std::less<>> identMap;
     size_t tabLevel;
 
-    std::string getBashIdentifier(std::string punchIdentifier) {
+    // number of internal variables generated so far in this scope
+    size_t variableCount;
+
+    // number of loops enclosing the statement being translated
+    size_t loopDepth;
+
+    // whether a function body is being translated
+    bool inFunction;
+
+    // functions whose self tail calls become jumps
+    std::unordered_set<const AstFunctionDecl*> tailRecursive;
+
+    // the function whose body is wrapped in a loop, if any
+    const AstFunctionDecl* tailFunction;
+
+    size_t memoLimit;
+
+    // whether the results of the current function are cached
+    bool memoizing;
+
+    // the function being translated, if any
+    std::string_view currentFunction;
+
+    // functions whose results some caller reads
+    std::unordered_set<std::string_view> usedResults;
+
+    // variables holding the results of calls hoisted out of their enclosing
+    // statement or line of raw code
+    std::unordered_map<const AstExpression*, std::string> callResults;
+
+    // a run of raw code, or an expression interpolated into it
+    struct RawPiece {
+        std::string_view text;
+        const AstExpression* expr;
+    };
+
+    std::string getBashIdentifier(std::string_view punchIdentifier) {
         auto pos = identMap.find(punchIdentifier);
         if (pos != identMap.end()) {
             return pos->second;
         }
 
         std::string name = generateIdentifier(punchIdentifier);
-        identMap[punchIdentifier] = name;
+        identMap[std::string(punchIdentifier)] = name;
         return name;
     }
 
-    std::string generateIdentifier(std::string punchIdentifier) {
-        std::stringstream name(punchIdentifier);
+    std::string generateIdentifier(std::string_view punchIdentifier) {
+        std::stringstream name{std::string(punchIdentifier)};
         auto pos = identMap.find(name.str());
         while (pos != identMap.end()) {
             name << "0";
@@ -59,23 +134,22 @@ private:
         return name.str();
     }
 
-    static std::string generateVariable() {
-        static size_t count = 0;
+    std::string generateVariable() {
         std::stringstream name;
-        name << "_internal_" << count++;
+        name << "_internal_" << variableCount++;
         return name.str();
     }
 
-    std::string tabs() const {
-        std::stringstream tabs;
-        for (size_t i = 0; i < tabLevel; i++) {
-            tabs << "    ";
-        }
-        return tabs.str();
-    }
-
-    void indent() {
-        os << tabs();
+    /**
+     * Emits the start of an assignment to a fresh internal variable, local to
+     * the enclosing function if there is one.
+     *
+     * @return the name of the variable
+     */
+    std::string declareTemporary() {
+        std::string name = generateVariable();
+        out << (inFunction ? "local " : "") << name << "=";
+        return name;
     }
 
     void tabInc() {
@@ -86,8 +160,152 @@ private:
         tabLevel--;
     }
 
-    void newLine() {
-        os << std::endl;
-        indent();
+    void newLine() { out.newLine(tabLevel); }
+
+    /**
+     * Checks whether a function's results are cached, which is only worth
+     * doing if some caller reads them.
+     */
+    bool isMemoized(const AstFunctionDecl* function) const {
+        return function->isMemoized() &&
+               usedResults.count(function->getName()) != 0;
     }
+
+    /**
+     * Gets the associative array caching a memoized function's results.
+     */
+    std::string getMemoCache(std::string_view punchIdentifier) {
+        return "_memo_" + getBashIdentifier(punchIdentifier);
+    }
+
+    /**
+     * Emits the start of a memoized function, which returns straight away
+     * if its arguments have been seen before.
+     */
+    void emitMemoLookup(const AstFunctionDecl* function);
+
+    /**
+     * Emits an assignment of an expression to a bash variable.
+     *
+     * @param declaration whether the assignment introduces the variable
+     */
+    void emitAssignment(const std::string& bID, const AstExpression* expr,
+                        bool declaration);
+
+    /**
+     * Emits a self tail call as updates to the parameters of the current
+     * function, ahead of jumping back to the top of its body.
+     */
+    void emitTailCall(const AstFunctionCall* call);
+
+    /**
+     * Emits an expression in a position where its value is used as a word,
+     * such as the right-hand side of an assignment.
+     */
+    void visitValue(const AstExpression* expr);
+
+    /**
+     * Emits an expression tree for evaluation inside a single enclosing
+     * arithmetic context, referring to variables by their bare names.
+     */
+    void emitArithmetic(const AstExpression* expr);
+
+    /**
+     * Emits the calls an expression depends on ahead of it, storing each
+     * result in a fresh variable for emitArithmetic and emitWord to use.
+     */
+    void hoistCalls(const AstExpression* expr);
+
+    /**
+     * Emits an assignment or expression statement inside an arithmetic
+     * context, such as the header of a for (( )) loop.
+     */
+    void emitArithmeticStatement(const AstStatement* stmt);
+
+    /**
+     * Emits the do ... done part of a loop.
+     *
+     * @param step a statement to run at the end of every iteration, or
+     * nullptr if there is none
+     */
+    void emitLoopBody(const AstStatementBlock* body, const AstStatement* step);
+
+    /**
+     * Checks whether raw code ends in a backslash escaping the newline after
+     * it, continuing the command onto the next line.
+     */
+    static bool isContinued(std::string_view text);
+
+    /**
+     * Emits one logical line of raw code, preceded by the calls made by the
+     * expressions interpolated into it.
+     *
+     * @param first whether this is the first line of its raw block; any
+     * other line starts by breaking the line before it
+     */
+    void emitRawLine(const std::vector<RawPiece>& line, bool first);
+
+    /**
+     * Emits the calls made by an expression interpolated into raw code,
+     * storing their results in fresh variables for emitWord to use. The
+     * rest of the expression is left to expand in place.
+     */
+    void hoistInterpolation(const AstExpression* expr);
+
+    /**
+     * Emits a condition as a test command for if or while, without forking.
+     *
+     * Conditions over numbers become a single (( )) test. Otherwise the
+     * condition is lowered to a chain of tests joined by the shell's own
+     * short-circuiting && and ||.
+     */
+    void emitCondition(const AstCondition* cond);
+
+    /**
+     * Emits a condition as an expression inside an arithmetic context.
+     */
+    void emitArithmeticCondition(const AstCondition* cond);
+
+    /**
+     * Emits a condition as a list of test commands.
+     */
+    void emitCommandCondition(const AstCondition* cond);
+
+    /**
+     * Emits a single comparison as a test command, running any calls it
+     * depends on first.
+     */
+    void emitComparisonCommand(const AstBinaryComparison* comp);
+
+    /**
+     * Emits an expression as a single word inside a [[ ]] test.
+     */
+    void emitWord(const AstExpression* expr);
+
+    /**
+     * Checks whether a condition can be tested in one arithmetic context,
+     * i.e. it compares numbers and needs no calls evaluated first.
+     */
+    static bool isArithmeticCondition(const AstCondition* cond);
+
+    /**
+     * Checks whether a statement can run inside an arithmetic context, i.e.
+     * it updates a variable to, or merely evaluates, a number computed
+     * without calls.
+     *
+     * Declarations are excluded, since they may need to be made local.
+     */
+    static bool isArithmeticStatement(const AstStatement* stmt);
+
+    /**
+     * Checks whether a comparison is between strings rather than numbers.
+     */
+    static bool isStringComparison(const AstBinaryComparison* comp);
+
+    /**
+     * Checks whether an expression needs statements emitted ahead of it,
+     * i.e. it involves a function call, possibly within a raw
+     * interpolation.
+     */
+    static bool hasCalls(const AstExpression* expr);
 };
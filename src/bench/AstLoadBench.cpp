@@ -0,0 +1,224 @@
+/**
+ * Compares loading an encoded AST against parsing its source again.
+ *
+ * Both sides start from text already in memory, as if mapped in by
+ * SourceBuffer, and end with the same program in a fresh arena: the parse
+ * runs the scanner and parser, the load decodes the output of
+ * AstBinary::write. Times are the best of the repetitions; allocation
+ * counts come from the first.
+ *
+ * Usage: AstLoadBench [--format json|csv] [--repeat N]
+ */
+
+#include "AllocationCounter.h"
+#include "ProgramGenerator.h"
+
+#include "AstArena.h"
+#include "AstBinary.h"
+#include "Parser.h"
+#include "Scanner.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchCase {
+    std::string name;
+    GeneratorOptions options;
+};
+
+struct StageResult {
+    double seconds = 0;
+    size_t allocations = 0;
+};
+
+struct BenchResult {
+    BenchCase benchCase;
+    size_t sourceBytes = 0;
+    size_t encodedBytes = 0;
+    size_t arenaBytes = 0;
+    StageResult parse;
+    StageResult encode;
+    StageResult load;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Runs a stage repeatedly, keeping the best time and the allocation count of
+ * the first run.
+ */
+template <class F>
+StageResult measure(size_t repeat, F stage) {
+    StageResult result;
+    for (size_t r = 0; r < repeat; r++) {
+        size_t allocsBefore = AllocationCounter::getCount();
+        auto start = Clock::now();
+        stage();
+        double seconds = secondsSince(start);
+        size_t allocs = AllocationCounter::getCount() - allocsBefore;
+
+        if (r == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        if (r == 0) {
+            result.allocations = allocs;
+        }
+    }
+    return result;
+}
+
+BenchResult runCase(const BenchCase& benchCase, size_t repeat) {
+    BenchResult result;
+    result.benchCase = benchCase;
+
+    std::string source = generateProgram(benchCase.options);
+    result.sourceBytes = source.size();
+
+    result.parse = measure(repeat, [&]() {
+        Scanner scanner(source);
+        AstArena arena;
+        Parser parser(scanner, arena);
+        parser.parse();
+        result.arenaBytes = arena.getAllocatedBytes();
+    });
+
+    // parse once more, keeping the program alive for the encoder
+    Scanner scanner(source);
+    AstArena arena;
+    Parser parser(scanner, arena);
+    AstProgram* program = parser.parse();
+
+    std::string encoded;
+    result.encode = measure(repeat, [&]() {
+        std::stringstream out;
+        AstBinary::write(program, out);
+        encoded = out.str();
+    });
+    result.encodedBytes = encoded.size();
+
+    result.load = measure(repeat, [&]() {
+        AstArena arena;
+        AstBinary::read(encoded, arena, benchCase.name);
+    });
+
+    return result;
+}
+
+std::vector<BenchCase> getSweep() {
+    std::vector<BenchCase> cases;
+    GeneratorOptions base;
+    cases.push_back({"base", base});
+
+    for (size_t functions : {1000, 10000}) {
+        GeneratorOptions options = base;
+        options.functionCount = functions;
+        cases.push_back({"functions-" + std::to_string(functions), options});
+    }
+    for (size_t depth : {6, 10}) {
+        GeneratorOptions options = base;
+        options.nestingDepth = depth;
+        cases.push_back({"depth-" + std::to_string(depth), options});
+    }
+    for (size_t length : {32, 512}) {
+        GeneratorOptions options = base;
+        options.expressionLength = length;
+        cases.push_back({"expr-" + std::to_string(length), options});
+    }
+    return cases;
+}
+
+double ratio(double parse, double load) { return load > 0 ? parse / load : 0; }
+
+void printCsv(const std::vector<BenchResult>& results) {
+    std::cout << "case,source_bytes,encoded_bytes,arena_bytes,parse_ms,"
+                 "encode_ms,load_ms,parse_allocs,encode_allocs,load_allocs,"
+                 "speedup"
+              << std::endl;
+    for (const auto& r : results) {
+        std::cout << r.benchCase.name << "," << r.sourceBytes << ","
+                  << r.encodedBytes << "," << r.arenaBytes << ","
+                  << r.parse.seconds * 1e3 << "," << r.encode.seconds * 1e3
+                  << "," << r.load.seconds * 1e3 << "," << r.parse.allocations
+                  << "," << r.encode.allocations << ","
+                  << r.load.allocations << ","
+                  << ratio(r.parse.seconds, r.load.seconds) << std::endl;
+    }
+}
+
+void printJson(const std::vector<BenchResult>& results) {
+    std::cout << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        std::cout << "  {\"case\": \"" << r.benchCase.name << "\", "
+                  << "\"source_bytes\": " << r.sourceBytes << ", "
+                  << "\"encoded_bytes\": " << r.encodedBytes << ", "
+                  << "\"arena_bytes\": " << r.arenaBytes << ", "
+                  << "\"parse_ms\": " << r.parse.seconds * 1e3 << ", "
+                  << "\"encode_ms\": " << r.encode.seconds * 1e3 << ", "
+                  << "\"load_ms\": " << r.load.seconds * 1e3 << ", "
+                  << "\"parse_allocs\": " << r.parse.allocations << ", "
+                  << "\"encode_allocs\": " << r.encode.allocations << ", "
+                  << "\"load_allocs\": " << r.load.allocations << ", "
+                  << "\"speedup\": "
+                  << ratio(r.parse.seconds, r.load.seconds) << "}"
+                  << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    std::cout << "]" << std::endl;
+}
+
+void printUsage() {
+    std::cerr << "Usage: AstLoadBench [--format json|csv] [--repeat N]"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string format = "json";
+    size_t repeat = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc) {
+            printUsage();
+            return 1;
+        }
+        const char* flag = argv[i];
+        const char* value = argv[++i];
+
+        if (std::strcmp(flag, "--format") == 0) {
+            format = value;
+        } else if (std::strcmp(flag, "--repeat") == 0) {
+            repeat = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (format != "json" && format != "csv") {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto& benchCase : getSweep()) {
+        results.push_back(runCase(benchCase, repeat));
+    }
+
+    if (format == "csv") {
+        printCsv(results);
+    } else {
+        printJson(results);
+    }
+    return 0;
+}
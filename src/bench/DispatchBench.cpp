@@ -0,0 +1,148 @@
+/**
+ * Microbenchmark comparing AstVisitor dispatch through the kind tag against
+ * the previous chain of dynamic_casts.
+ *
+ * Usage: DispatchBench [NODES] [ROUNDS]
+ */
+
+#include "AstArena.h"
+#include "AstVisitor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+class CountingVisitor : public AstVisitor<size_t> {
+public:
+    /**
+     * Dispatches the same way AstVisitor::visit did before nodes carried a
+     * kind tag, for comparison.
+     */
+    size_t visitWithDynamicCast(const AstNode* node) {
+
+#define LEAF(Kind)                                                             \
+    if (const auto* n = dynamic_cast<const Ast##Kind*>(node))                  \
+        return visit##Kind(n);
+
+        LEAF(Program);
+        LEAF(FunctionDecl);
+        LEAF(Variable);
+        LEAF(Assignment);
+        LEAF(BinaryExpression);
+        LEAF(NumberLiteral);
+        LEAF(StringLiteral);
+        LEAF(FunctionCall);
+        LEAF(RawBashExpression);
+        LEAF(RawPunchExpression);
+        LEAF(RawEnvironment);
+        LEAF(Return);
+        LEAF(SimpleConditional);
+        LEAF(BranchingConditional);
+        LEAF(ForLoop);
+        LEAF(WhileLoop);
+        LEAF(True);
+        LEAF(False);
+        LEAF(StatementBlock);
+        LEAF(BinaryComparison);
+        LEAF(Conjunction);
+        LEAF(Disjunction);
+        LEAF(Negation);
+
+#undef LEAF
+
+        assert(false && "missing visitor type");
+    }
+
+protected:
+    size_t visitNode(const AstNode* node) override {
+        return static_cast<size_t>(node->getKind());
+    }
+};
+
+std::vector<AstNode*> makeNodes(AstArena& arena, size_t count) {
+    auto* var = arena.create<AstVariable>("x");
+    auto* num = arena.create<AstNumberLiteral>(1);
+    auto* cond = arena.create<AstTrue>();
+
+    // one of every concrete node type, visited round-robin
+    std::vector<AstNode*> kinds = {
+        arena.create<AstProgram>(arena),
+        arena.create<AstFunctionDecl>(arena, "f"),
+        var,
+        arena.create<AstAssignment>(true, var, num),
+        arena.create<AstBinaryExpression>(BinaryOperator::ADD, var, num),
+        num,
+        arena.create<AstStringLiteral>("s"),
+        arena.create<AstFunctionCall>(arena, "f"),
+        arena.create<AstRawBashExpression>("echo"),
+        arena.create<AstRawPunchExpression>(var),
+        arena.create<AstRawEnvironment>(arena),
+        arena.create<AstReturn>(var),
+        arena.create<AstSimpleConditional>(cond, var),
+        arena.create<AstBranchingConditional>(cond, var, var),
+        arena.create<AstForLoop>(var, cond, var,
+                                 arena.create<AstStatementBlock>(arena)),
+        arena.create<AstWhileLoop>(cond,
+                                   arena.create<AstStatementBlock>(arena)),
+        cond,
+        arena.create<AstFalse>(),
+        arena.create<AstStatementBlock>(arena),
+        arena.create<AstBinaryComparison>(ComparisonOperator::LT, var, num),
+        arena.create<AstConjunction>(cond, cond),
+        arena.create<AstDisjunction>(cond, cond),
+        arena.create<AstNegation>(cond),
+    };
+
+    std::vector<AstNode*> nodes;
+    nodes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        nodes.push_back(kinds[(i * 7) % kinds.size()]);
+    }
+    return nodes;
+}
+
+template <class F>
+double timePerNode(const std::vector<AstNode*>& nodes, size_t rounds, F f) {
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        for (const auto* node : nodes) {
+            checksum += f(node);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // keep the loop from being optimised away
+    if (checksum == 1) {
+        std::cerr << "";
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / (nodes.size() * rounds);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t rounds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+    AstArena arena;
+    std::vector<AstNode*> nodes = makeNodes(arena, count);
+    CountingVisitor visitor;
+
+    double tagged = timePerNode(nodes, rounds, [&](const AstNode* node) {
+        return visitor.visit(node);
+    });
+    double cascaded = timePerNode(nodes, rounds, [&](const AstNode* node) {
+        return visitor.visitWithDynamicCast(node);
+    });
+
+    std::cout << "nodes: " << count << " x " << rounds << std::endl;
+    std::cout << "kind switch:   " << tagged << " ns/node" << std::endl;
+    std::cout << "dynamic_cast:  " << cascaded << " ns/node" << std::endl;
+    return 0;
+}
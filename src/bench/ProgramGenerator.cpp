@@ -0,0 +1,120 @@
+#include "ProgramGenerator.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+class Generator {
+public:
+    Generator(const GeneratorOptions& options)
+        : options(options), random(options.seed) {}
+
+    std::string run() {
+        out += "var g = " + std::to_string(literal()) + ";\n";
+        for (size_t i = 0; i < options.functionCount; i++) {
+            generateFunction(i);
+        }
+
+        out += "func main() {\n";
+        out += "    var r = 0;\n";
+        for (size_t i = 0; i < options.functionCount; i++) {
+            out += "    r = f" + std::to_string(i) + "(r, " +
+                   std::to_string(literal()) + ");\n";
+        }
+        out += "    raw { echo \"$[r]\" }\n";
+        out += "}\n";
+        return std::move(out);
+    }
+
+private:
+    const GeneratorOptions& options;
+    std::mt19937 random;
+    std::string out;
+
+    int literal() { return random() % 100; }
+
+    void indent(size_t level) { out.append(4 * level, ' '); }
+
+    /**
+     * Appends an arithmetic expression over the parameters, x and g.
+     */
+    void generateExpression() {
+        static const char* operands[] = {"a", "b", "x", "g"};
+        static const char* operators[] = {" + ", " - ", " * ", " / ", " % "};
+
+        size_t length = std::max<size_t>(1, options.expressionLength);
+        for (size_t i = 0; i < length; i++) {
+            if (i > 0) {
+                out += operators[random() % 5];
+            }
+            if (random() % 2 == 0) {
+                out += operands[random() % 4];
+            } else {
+                // avoid dividing by a zero literal
+                out += std::to_string(literal() + 1);
+            }
+        }
+    }
+
+    void generateFunction(size_t index) {
+        out += "func f" + std::to_string(index) + "(a, b) {\n";
+        indent(1);
+        out += "var x = ";
+        generateExpression();
+        out += ";\n";
+        if (index > 0) {
+            indent(1);
+            out += "x = f" + std::to_string(index - 1) + "(x, a);\n";
+        }
+        generateNest(1, options.nestingDepth);
+        indent(1);
+        out += "return x;\n";
+        out += "}\n";
+    }
+
+    void generateNest(size_t level, size_t remaining) {
+        if (remaining == 0) {
+            generateRaw(level);
+            return;
+        }
+
+        static const char* comparisons[] = {" < ", " <= ", " > ", " == "};
+
+        indent(level);
+        out += "if (x";
+        out += comparisons[random() % 4];
+        out += std::to_string(literal()) + ") {\n";
+        generateNest(level + 1, remaining - 1);
+        indent(level);
+        out += "} else {\n";
+        indent(level + 1);
+        out += "x = ";
+        generateExpression();
+        out += ";\n";
+        indent(level);
+        out += "}\n";
+    }
+
+    void generateRaw(size_t level) {
+        if (options.rawLines == 0) {
+            return;
+        }
+
+        indent(level);
+        out += "raw {\n";
+        for (size_t i = 0; i < options.rawLines; i++) {
+            indent(level + 1);
+            out += "echo \"line " + std::to_string(i) +
+                   ": $[x] and $[a]\" | grep -v foo\n";
+        }
+        indent(level);
+        out += "}\n";
+    }
+};
+
+} // namespace
+
+std::string generateProgram(const GeneratorOptions& options) {
+    return Generator(options).run();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Shape of a synthetic punch program.
+ */
+struct GeneratorOptions {
+    // number of functions besides main
+    size_t functionCount = 100;
+
+    // depth of the if/else nest inside each function
+    size_t nestingDepth = 2;
+
+    // lines in the raw block at the innermost level of each nest
+    size_t rawLines = 2;
+
+    // number of operands in each generated arithmetic expression
+    size_t expressionLength = 4;
+
+    // seed for choosing operators and literals
+    uint32_t seed = 1;
+};
+
+/**
+ * Generates a punch program with the given shape.
+ *
+ * Only constructs the current parser accepts are used, so the result always
+ * compiles. The same options always produce the same program.
+ *
+ * @param options the shape of the program
+ * @return the source text
+ */
+std::string generateProgram(const GeneratorOptions& options);
@@ -0,0 +1,304 @@
+/**
+ * Times each compiler stage on synthetic punch programs.
+ *
+ * The scanner is timed on its own by pulling every token from it. The parser
+ * pulls tokens from the scanner on demand, so the parse time includes
+ * scanning. The translator is timed on an already-parsed program, writing
+ * into a stream that discards its output. Times are the best of the
+ * repetitions; allocation counts come from the first.
+ *
+ * Without any shape options a fixed sweep is run that scales each dimension
+ * of the program in turn; otherwise the single requested shape is run.
+ *
+ * Usage: StageBench [--format json|csv] [--repeat N] [--functions N]
+ *                   [--depth N] [--raw-lines N] [--expr-length N] [--seed N]
+ */
+
+#include "AllocationCounter.h"
+#include "ProgramGenerator.h"
+
+#include "AstArena.h"
+#include "CodeEmitter.h"
+#include "Parser.h"
+#include "Scanner.h"
+#include "Translator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * Stream buffer that accepts and drops everything written to it.
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        return n;
+    }
+};
+
+struct BenchCase {
+    std::string name;
+    GeneratorOptions options;
+};
+
+struct StageResult {
+    double seconds = 0;
+    size_t allocations = 0;
+};
+
+struct BenchResult {
+    BenchCase benchCase;
+    size_t sourceBytes = 0;
+    size_t lines = 0;
+    size_t tokens = 0;
+    size_t arenaBytes = 0;
+    size_t outputBytes = 0;
+    StageResult scan;
+    StageResult parse;
+    StageResult translate;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Runs a stage repeatedly, keeping the best time and the allocation count of
+ * the first run.
+ */
+template <class F>
+StageResult measure(size_t repeat, F stage) {
+    StageResult result;
+    for (size_t r = 0; r < repeat; r++) {
+        size_t allocsBefore = AllocationCounter::getCount();
+        auto start = Clock::now();
+        stage();
+        double seconds = secondsSince(start);
+        size_t allocs = AllocationCounter::getCount() - allocsBefore;
+
+        if (r == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        if (r == 0) {
+            result.allocations = allocs;
+        }
+    }
+    return result;
+}
+
+BenchResult runCase(const BenchCase& benchCase, size_t repeat) {
+    BenchResult result;
+    result.benchCase = benchCase;
+
+    std::string source = generateProgram(benchCase.options);
+    result.sourceBytes = source.size();
+    result.lines = std::count(source.begin(), source.end(), '\n');
+
+    result.scan = measure(repeat, [&]() {
+        Scanner scanner(source);
+        size_t tokens = 0;
+        while (scanner.next().type != TokenType::END) {
+            tokens++;
+        }
+        result.tokens = tokens;
+    });
+
+    result.parse = measure(repeat, [&]() {
+        Scanner scanner(source);
+        AstArena arena;
+        Parser parser(scanner, arena);
+        parser.parse();
+        result.arenaBytes = arena.getAllocatedBytes();
+    });
+
+    // parse once more, keeping the program alive for the translator
+    Scanner scanner(source);
+    AstArena arena;
+    Parser parser(scanner, arena);
+    AstProgram* program = parser.parse();
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    result.translate = measure(repeat, [&]() {
+        CodeEmitter emitter(nullStream);
+        Translator translator(emitter, program);
+        translator.run();
+        emitter.flush();
+        result.outputBytes = emitter.getByteCount();
+    });
+
+    return result;
+}
+
+std::vector<BenchCase> getSweep() {
+    std::vector<BenchCase> cases;
+    GeneratorOptions base;
+    cases.push_back({"base", base});
+
+    for (size_t functions : {1000, 10000}) {
+        GeneratorOptions options = base;
+        options.functionCount = functions;
+        cases.push_back({"functions-" + std::to_string(functions), options});
+    }
+    for (size_t depth : {6, 10}) {
+        GeneratorOptions options = base;
+        options.nestingDepth = depth;
+        cases.push_back({"depth-" + std::to_string(depth), options});
+    }
+    for (size_t rawLines : {32, 512}) {
+        GeneratorOptions options = base;
+        options.rawLines = rawLines;
+        cases.push_back({"raw-" + std::to_string(rawLines), options});
+    }
+    for (size_t length : {32, 512}) {
+        GeneratorOptions options = base;
+        options.expressionLength = length;
+        cases.push_back({"expr-" + std::to_string(length), options});
+    }
+    return cases;
+}
+
+double perSecond(size_t count, double seconds) {
+    return seconds > 0 ? count / seconds : 0;
+}
+
+void printCsv(const std::vector<BenchResult>& results) {
+    std::cout << "case,functions,depth,raw_lines,expr_length,source_bytes,"
+                 "lines,tokens,arena_bytes,output_bytes,scan_ms,parse_ms,"
+                 "translate_ms,scan_allocs,parse_allocs,translate_allocs,"
+                 "tokens_per_sec,lines_per_sec"
+              << std::endl;
+    for (const auto& r : results) {
+        const GeneratorOptions& o = r.benchCase.options;
+        std::cout << r.benchCase.name << "," << o.functionCount << ","
+                  << o.nestingDepth << "," << o.rawLines << ","
+                  << o.expressionLength << "," << r.sourceBytes << ","
+                  << r.lines << "," << r.tokens << "," << r.arenaBytes << ","
+                  << r.outputBytes << "," << r.scan.seconds * 1e3 << ","
+                  << r.parse.seconds * 1e3 << ","
+                  << r.translate.seconds * 1e3 << "," << r.scan.allocations
+                  << "," << r.parse.allocations << ","
+                  << r.translate.allocations << ","
+                  << perSecond(r.tokens, r.scan.seconds) << ","
+                  << perSecond(r.lines,
+                               r.parse.seconds + r.translate.seconds)
+                  << std::endl;
+    }
+}
+
+void printJson(const std::vector<BenchResult>& results) {
+    std::cout << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        const GeneratorOptions& o = r.benchCase.options;
+        std::cout << "  {\"case\": \"" << r.benchCase.name << "\", "
+                  << "\"functions\": " << o.functionCount << ", "
+                  << "\"depth\": " << o.nestingDepth << ", "
+                  << "\"raw_lines\": " << o.rawLines << ", "
+                  << "\"expr_length\": " << o.expressionLength << ", "
+                  << "\"source_bytes\": " << r.sourceBytes << ", "
+                  << "\"lines\": " << r.lines << ", "
+                  << "\"tokens\": " << r.tokens << ", "
+                  << "\"arena_bytes\": " << r.arenaBytes << ", "
+                  << "\"output_bytes\": " << r.outputBytes << ", "
+                  << "\"scan_ms\": " << r.scan.seconds * 1e3 << ", "
+                  << "\"parse_ms\": " << r.parse.seconds * 1e3 << ", "
+                  << "\"translate_ms\": " << r.translate.seconds * 1e3 << ", "
+                  << "\"scan_allocs\": " << r.scan.allocations << ", "
+                  << "\"parse_allocs\": " << r.parse.allocations << ", "
+                  << "\"translate_allocs\": " << r.translate.allocations
+                  << ", "
+                  << "\"tokens_per_sec\": "
+                  << perSecond(r.tokens, r.scan.seconds) << ", "
+                  << "\"lines_per_sec\": "
+                  << perSecond(r.lines, r.parse.seconds + r.translate.seconds)
+                  << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    std::cout << "]" << std::endl;
+}
+
+void printUsage() {
+    std::cerr << "Usage: StageBench [--format json|csv] [--repeat N] "
+                 "[--functions N] [--depth N] [--raw-lines N] "
+                 "[--expr-length N] [--seed N]"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string format = "json";
+    size_t repeat = 5;
+    GeneratorOptions options;
+    bool custom = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc) {
+            printUsage();
+            return 1;
+        }
+        const char* flag = argv[i];
+        const char* value = argv[++i];
+        size_t number = std::strtoull(value, nullptr, 10);
+
+        if (std::strcmp(flag, "--format") == 0) {
+            format = value;
+        } else if (std::strcmp(flag, "--repeat") == 0) {
+            repeat = std::max<size_t>(1, number);
+        } else if (std::strcmp(flag, "--functions") == 0) {
+            options.functionCount = number;
+            custom = true;
+        } else if (std::strcmp(flag, "--depth") == 0) {
+            options.nestingDepth = number;
+            custom = true;
+        } else if (std::strcmp(flag, "--raw-lines") == 0) {
+            options.rawLines = number;
+            custom = true;
+        } else if (std::strcmp(flag, "--expr-length") == 0) {
+            options.expressionLength = std::max<size_t>(1, number);
+            custom = true;
+        } else if (std::strcmp(flag, "--seed") == 0) {
+            options.seed = number;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (format != "json" && format != "csv") {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<BenchCase> cases;
+    if (custom) {
+        cases.push_back({"custom", options});
+    } else {
+        cases = getSweep();
+        for (auto& benchCase : cases) {
+            benchCase.options.seed = options.seed;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto& benchCase : cases) {
+        results.push_back(runCase(benchCase, repeat));
+    }
+
+    if (format == "csv") {
+        printCsv(results);
+    } else {
+        printJson(results);
+    }
+    return 0;
+}
@@ -1,53 +1,316 @@
-#include "Parser.h"
-#include "Scanner.h"
-#include "Translator.h"
+#include "CompileCache.h"
+#include "CompileServer.h"
+#include "CompileStats.h"
+#include "Driver.h"
+#include "PunchException.h"
 
-#include <fstream>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
 
-void printUsage() { std::cout << "Usage: punch INFILE [OUTFILE]" << std::endl; }
+void printUsage() {
+    std::cout << "Usage: punch [OPTIONS] INFILE [OUTFILE]" << std::endl;
+    std::cout << "       punch [OPTIONS] --batch OUTDIR [-j N] "
+                 "[--manifest FILE] [INFILE...]"
+              << std::endl;
+    std::cout << "       punch [OPTIONS] -c INFILE [OBJFILE]" << std::endl;
+    std::cout << "       punch --link OUTFILE OBJFILE..." << std::endl;
+    std::cout << "       punch --emit-ast INFILE [ASTFILE]" << std::endl;
+    std::cout << "       punch [OPTIONS] --serve SOCKET [-j N]" << std::endl;
+    std::cout << "Use '-' as INFILE to read from stdin." << std::endl;
+    std::cout << "In batch mode, each INFILE is compiled to OUTDIR/<name>.sh "
+                 "in parallel."
+              << std::endl;
+    std::cout << "With -c, a module is compiled on its own, to be linked with "
+                 "the modules it"
+              << std::endl;
+    std::cout << "imports by --link; list each object after those it imports."
+              << std::endl;
+    std::cout << "With --emit-ast, a source is only parsed, and its AST "
+                 "written out to be"
+              << std::endl;
+    std::cout << "compiled later with --from-ast, skipping the parse."
+              << std::endl;
+    std::cout << "In server mode, punch stays running and compiles for "
+                 "clients started with"
+              << std::endl;
+    std::cout << "--connect SOCKET; the clients choose the other options."
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --no-fold    do not evaluate constant arithmetic at "
+                 "compile time"
+              << std::endl;
+    std::cout << "  --no-inline  do not inline calls to small functions"
+              << std::endl;
+    std::cout << "  --no-dce     keep unreachable statements and functions"
+              << std::endl;
+    std::cout << "  --no-hoist   do not move loop-invariant arithmetic out of "
+                 "loops"
+              << std::endl;
+    std::cout << "  --memoize    cache the results of all pure functions, "
+                 "not just @memo ones"
+              << std::endl;
+    std::cout << "  --memo-limit N" << std::endl;
+    std::cout << "               empty a function's cache once it holds N "
+                 "results"
+              << std::endl;
+    std::cout << "  --from-ast   read INFILE as an AST written by --emit-ast"
+              << std::endl;
+    std::cout << "  --cache DIR  reuse scripts compiled before, kept in DIR"
+              << std::endl;
+    std::cout << "  --cache-size MB" << std::endl;
+    std::cout << "               evict the least recently used scripts past "
+                 "MB megabytes (default 64)"
+              << std::endl;
+    std::cout << "  --cache-stats" << std::endl;
+    std::cout << "               report cache hits and misses on stderr"
+              << std::endl;
+    std::cout << "  --connect SOCKET" << std::endl;
+    std::cout << "               compile through the server on SOCKET, if "
+                 "one is running"
+              << std::endl;
+    std::cout << "  --stats      report the time and allocations of each "
+                 "stage on stderr"
+              << std::endl;
+    std::cout << "  --stats-json report the same as a JSON object"
+              << std::endl;
+}
+
+/**
+ * Parses a non-negative count given on the command line.
+ *
+ * @return whether the text was a valid count
+ */
+bool parseCount(const std::string& text, size_t& value) {
+    char* end;
+    long result = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || result < 0) {
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+int runBatch(const std::vector<std::string>& args,
+             const Driver::CompileOptions& options) {
+    if (args.size() < 2) {
+        printUsage();
+        return 1;
+    }
 
-void compileProgram(std::string filename, std::ostream& out) {
-    // read in the source code
-    std::stringstream source;
-    std::ifstream file(filename);
-    source << file.rdbuf();
+    std::string outDirectory = args[1];
+    std::vector<std::string> inFilenames;
+    size_t jobCount = 0;
 
-    // run the scanner
-    Scanner scanner(source.str());
+    try {
+        for (size_t i = 2; i < args.size(); i++) {
+            const std::string& arg = args[i];
+            if ((arg == "-j" || arg == "--manifest") && i + 1 == args.size()) {
+                printUsage();
+                return 1;
+            }
 
-    // run the parser
-    Parser parser(scanner.getTokens());
-    AstProgram* program = parser.parse();
+            if (arg == "-j") {
+                if (!parseCount(args[++i], jobCount)) {
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--manifest") {
+                for (auto& filename : Driver::readManifest(args[++i])) {
+                    inFilenames.push_back(std::move(filename));
+                }
+            } else {
+                inFilenames.push_back(arg);
+            }
+        }
 
-    // translate and write result to out
-    Translator translator(out, program);
-    translator.run();
+        size_t failures =
+            Driver::compileBatch(inFilenames, outDirectory, jobCount, options);
+        return failures == 0 ? 0 : 1;
+    } catch (const PunchException& e) {
+        PunchException::handleException(e);
+        return 1;
+    }
 }
 
-int main(int argc, char** argv) {
-    // expecting strictly 1 or 2 arguments
-    if (argc != 2 && argc != 3) {
+int runServer(const std::vector<std::string>& args,
+              const Driver::CompileOptions& options) {
+    size_t jobCount = 0;
+    bool valid = args.size() == 2 ||
+                 (args.size() == 4 && args[2] == "-j" &&
+                  parseCount(args[3], jobCount));
+    if (!valid) {
         printUsage();
         return 1;
     }
 
-    // compile the program
-    std::string inFilename = argv[1];
-    std::stringstream result;
-    compileProgram(inFilename, result);
+    try {
+        CompileServer::serve(args[1], jobCount, options.cache);
+    } catch (const PunchException& e) {
+        PunchException::handleException(e);
+    }
+    return 1;
+}
+
+int runSeparate(const std::vector<std::string>& args,
+                const Driver::CompileOptions& options) {
+    bool compiling = args[0] == "-c";
+    bool emitting = args[0] == "--emit-ast";
+    bool valid = compiling || emitting ? args.size() == 2 || args.size() == 3
+                                       : args.size() >= 3;
+    if (!valid) {
+        printUsage();
+        return 1;
+    }
+
+    try {
+        if (compiling) {
+            std::string outFilename = args.size() == 3 ? args[2] : "";
+            Driver::compileObject(args[1], outFilename, options);
+        } else if (emitting) {
+            std::string outFilename = args.size() == 3 ? args[2] : "";
+            Driver::emitAst(args[1], outFilename);
+        } else {
+            std::vector<std::string> inFilenames(args.begin() + 2, args.end());
+            Driver::linkObjects(inFilenames, args[1]);
+        }
+    } catch (const PunchException& e) {
+        PunchException::handleException(e);
+        return 1;
+    }
+    return 0;
+}
+
+int compile(const std::vector<std::string>& args,
+            const Driver::CompileOptions& options,
+            const std::string& socketPath) {
+    if (!args.empty() && args[0] == "--batch") {
+        return runBatch(args, options);
+    }
+    if (!args.empty() && args[0] == "--serve") {
+        return runServer(args, options);
+    }
+    if (!args.empty() && (args[0] == "-c" || args[0] == "--link" ||
+                          args[0] == "--emit-ast")) {
+        return runSeparate(args, options);
+    }
+
+    // otherwise, expecting strictly 1 or 2 arguments
+    if (args.size() != 1 && args.size() != 2) {
+        printUsage();
+        return 1;
+    }
 
-    // decide where to write the result
-    if (argc == 3) {
-        // write to file
-        std::string outFilename = argv[2];
-        std::ofstream outFile(outFilename);
-        outFile << result.str();
-    } else {
-        // write to stdout
-        std::cout << result.str();
+    // compile the program, writing to stdout if no output file is given
+    std::string inFilename = args[0];
+    std::string outFilename = args.size() == 2 ? args[1] : "";
+    try {
+        // stdin cannot be handed over to a server, and a server's stages
+        // cannot be measured here
+        std::error_code err;
+        bool forwarded = !socketPath.empty() && inFilename != "-" &&
+                         options.stats == nullptr &&
+                         std::filesystem::is_socket(socketPath, err) &&
+                         CompileServer::forward(socketPath, inFilename,
+                                                outFilename, options);
+        if (!forwarded) {
+            Driver::compileFile(inFilename, outFilename, options);
+        }
+    } catch (const PunchException& e) {
+        PunchException::handleException(e);
+        return 1;
     }
 
     return 0;
 }
+
+int main(int argc, char** argv) {
+    // pull out the compilation options, leaving the rest in order
+    Driver::CompileOptions options;
+    std::vector<std::string> args;
+    std::string cacheDirectory;
+    std::string socketPath;
+    size_t cacheMegabytes = CompileCache::DEFAULT_MAX_BYTES >> 20;
+    bool cacheStats = false;
+    bool stats = false;
+    bool statsJson = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool takesValue = arg == "--memo-limit" || arg == "--cache" ||
+                          arg == "--cache-size" || arg == "--connect";
+        if (takesValue && i + 1 == argc) {
+            printUsage();
+            return 1;
+        }
+
+        if (arg == "--no-fold") {
+            options.foldConstants = false;
+        } else if (arg == "--no-inline") {
+            options.inlineFunctions = false;
+        } else if (arg == "--no-dce") {
+            options.eliminateDeadCode = false;
+        } else if (arg == "--no-hoist") {
+            options.hoistInvariants = false;
+        } else if (arg == "--memoize") {
+            options.memoizeAll = true;
+        } else if (arg == "--from-ast") {
+            options.astInput = true;
+        } else if (arg == "--memo-limit") {
+            if (!parseCount(argv[++i], options.memoLimit)) {
+                printUsage();
+                return 1;
+            }
+        } else if (arg == "--cache") {
+            cacheDirectory = argv[++i];
+        } else if (arg == "--cache-size") {
+            if (!parseCount(argv[++i], cacheMegabytes)) {
+                printUsage();
+                return 1;
+            }
+        } else if (arg == "--cache-stats") {
+            cacheStats = true;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--stats-json") {
+            stats = true;
+            statsJson = true;
+        } else if (arg == "--connect") {
+            socketPath = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    std::unique_ptr<CompileCache> cache;
+    if (!cacheDirectory.empty()) {
+        cache = std::make_unique<CompileCache>(
+            cacheDirectory, uint64_t(cacheMegabytes) << 20);
+        options.cache = cache.get();
+    }
+
+    CompileStats compileStats;
+    if (stats) {
+        options.stats = &compileStats;
+    }
+
+    int result = compile(args, options, socketPath);
+
+    if (statsJson) {
+        compileStats.printJson(std::cerr);
+    } else if (stats) {
+        compileStats.print(std::cerr);
+    }
+
+    if (cacheStats && cache != nullptr) {
+        CompileCache::Statistics stats = cache->getStatistics();
+        std::cerr << "cache: " << stats.hits << " hits, " << stats.misses
+                  << " misses, " << stats.stores << " stored, "
+                  << stats.evictions << " evicted" << std::endl;
+    }
+
+    return result;
+}